@@ -1,43 +1,162 @@
 #include "aux_module.h"
 
+#include <stdexcept>
 
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define AUX_HAVE_MMAP 1
+#endif
 
-Vecr operator-(Vecr const& vec1, Vecr const& vec2) {
 
-    int vec_sz = vec1.size();
-    Vecr res(vec_sz, 0.0);
-    for(int i = 0; i < vec_sz; ++i) {
-        res[i] = vec1[i] - vec2[i];
+
+double lc_norm(Vecr const& Vecr) {
+
+    double norm = 0.0;
+    int Vecr_sz = Vecr.size();
+    for(int i = 0; i < Vecr_sz; ++i) {
+        norm = std::max(norm, std::abs(Vecr[i]));
     }
-    return res;
+    return norm;
 
 }
 
 
-Vecr operator*(Vecr const& vec, double num) {
+void axpy(double a, Vecr const& x, Vecr& y) {
 
-    int vec_sz = vec.size();
-    Vecr res(vec_sz, 0.0);
-    for(int i = 0; i < vec_sz; ++i) {
-        res[i] = vec[i] * num;
+    const size_t sz = x.size();
+    const double* px = x.data();
+    double* py = y.data();
+    for (size_t i = 0; i < sz; ++i) {
+        py[i] += a * px[i];
     }
-    return res;
 
 }
 
 
-Vecr operator*(double num, Vecr const& vec) {
-    return vec * num;
+void sub_into(Vecr const& vec1, Vecr const& vec2, Vecr& res) {
+
+    const size_t sz = vec1.size();
+    const double* p1 = vec1.data();
+    const double* p2 = vec2.data();
+    double* pr = res.data();
+    for (size_t i = 0; i < sz; ++i) {
+        pr[i] = p1[i] - p2[i];
+    }
+
 }
 
 
-double lc_norm(Vecr const& Vecr) {
+double max_abs_diff(Vecr const& vec1, Vecr const& vec2) {
 
     double norm = 0.0;
-    int Vecr_sz = Vecr.size();
-    for(int i = 0; i < Vecr_sz; ++i) {
-        norm = std::max(norm, std::abs(Vecr[i]));
+    const size_t sz = vec1.size();
+    const double* p1 = vec1.data();
+    const double* p2 = vec2.data();
+    for (size_t i = 0; i < sz; ++i) {
+        norm = std::max(norm, std::abs(p1[i] - p2[i]));
     }
     return norm;
 
-}
\ No newline at end of file
+}
+
+
+// реализация отображения файлов
+
+#ifdef AUX_HAVE_MMAP
+
+MappedFile::MappedFile(std::string const& path) {
+
+    fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    bytes = (size_t)st.st_size;
+    if (bytes == 0) return;
+
+    ptr = ::mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        ptr = nullptr;
+        ::close(fd);
+        throw std::runtime_error("cannot map " + path);
+    }
+    ::madvise(ptr, bytes, MADV_SEQUENTIAL);
+
+}
+
+
+MappedFile::MappedFile(std::string const& path, size_t bytes)
+    : bytes(bytes)
+    , writable(true)
+{
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) throw std::runtime_error("cannot create " + path);
+    if (::ftruncate(fd, (off_t)bytes) != 0) {
+        ::close(fd);
+        throw std::runtime_error("cannot resize " + path);
+    }
+    if (bytes == 0) return;
+
+    ptr = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ptr == MAP_FAILED) {
+        ptr = nullptr;
+        ::close(fd);
+        throw std::runtime_error("cannot map " + path);
+    }
+
+}
+
+
+MappedFile::~MappedFile() {
+
+    if (ptr) {
+        if (writable) ::msync(ptr, bytes, MS_SYNC);
+        ::munmap(ptr, bytes);
+    }
+    if (fd >= 0) ::close(fd);
+
+}
+
+
+void MappedFile::release(size_t offset, size_t len) {
+
+    if (!ptr || offset >= bytes) return;
+
+    // границы выравниваются внутрь диапазона по страницам
+    const size_t page = (size_t)::sysconf(_SC_PAGESIZE);
+    size_t begin = (offset + page - 1) / page * page;
+    size_t end = std::min(bytes, offset + len) / page * page;
+    if (begin >= end) return;
+
+    char* base = static_cast<char*>(ptr);
+    if (writable) ::msync(base + begin, end - begin, MS_ASYNC);
+    ::madvise(base + begin, end - begin, MADV_DONTNEED);
+
+}
+
+#else
+
+MappedFile::MappedFile(std::string const&) {
+    throw std::runtime_error("memory-mapped files are not supported on this platform");
+}
+
+
+MappedFile::MappedFile(std::string const&, size_t) {
+    throw std::runtime_error("memory-mapped files are not supported on this platform");
+}
+
+
+MappedFile::~MappedFile() {
+}
+
+
+void MappedFile::release(size_t, size_t) {
+}
+
+#endif
\ No newline at end of file
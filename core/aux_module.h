@@ -8,32 +8,394 @@
 #include <random>
 #include <algorithm>
 #include <numeric>
+#include <type_traits>
+#include <new>
+#include <cstddef>
+#include <thread>
+#include <atomic>
+#include <string>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
 
 
 const double pi = std::acos(-1.0); // число Pi
 
 using Vecr = std::vector<double>; // синоним для вещественного вектора
-using Matrix = std::vector<Vecr>; // синоним для вещественной матрицы
 
 
 
-Vecr operator-(Vecr const& Vec1, Vecr const& Vec2); // оператор вычитания векторов
+// ленивые выражения над Vecr: операторы не выделяют память, а возвращают узел выражения,
+// который вычисляется одним слитым циклом при записи в вектор (eval_into) или при свёртке (lc_norm)
 
+template <class E> struct is_vec_expr : std::false_type {};
+template <> struct is_vec_expr<Vecr> : std::true_type {};
 
-Vecr operator*(Vecr const& Vec, double num); // оператор умножения вектора на число
 
+// Vecr хранится в выражении по ссылке, узлы выражений - по значению
+template <class E> struct vec_operand { using type = E; };
+template <> struct vec_operand<Vecr> { using type = Vecr const&; };
 
-Vecr operator*(double num, Vecr const& Vec); // оператор умножения вектора на число
+
+template <class A, class B>
+struct VecSubExpr {
+
+    typename vec_operand<A>::type a;
+    typename vec_operand<B>::type b;
+
+    double operator[](size_t i) const { return a[i] - b[i]; }
+    size_t size() const { return a.size(); }
+    operator Vecr() const; // вычисление с выделением памяти, для совместимости со старым синтаксисом
+
+};
+
+
+template <class A>
+struct VecScaleExpr {
+
+    typename vec_operand<A>::type a;
+    double num;
+
+    double operator[](size_t i) const { return a[i] * num; }
+    size_t size() const { return a.size(); }
+    operator Vecr() const;
+
+};
+
+template <class A, class B> struct is_vec_expr<VecSubExpr<A, B>> : std::true_type {};
+template <class A> struct is_vec_expr<VecScaleExpr<A>> : std::true_type {};
+
+
+template <class E>
+using enable_vec_expr = std::enable_if_t<is_vec_expr<E>::value, int>;
+
+
+// вычисление выражения в уже выделенную память dst (dst.size() >= expr.size())
+template <class E, enable_vec_expr<E> = 0>
+void eval_into(Vecr& dst, E const& expr) {
+
+    const size_t sz = expr.size();
+    double* out = dst.data();
+    for (size_t i = 0; i < sz; ++i) {
+        out[i] = expr[i];
+    }
+
+}
+
+
+template <class A, class B>
+VecSubExpr<A, B>::operator Vecr() const {
+    Vecr res(size());
+    eval_into(res, *this);
+    return res;
+}
+
+
+template <class A>
+VecScaleExpr<A>::operator Vecr() const {
+    Vecr res(size());
+    eval_into(res, *this);
+    return res;
+}
+
+
+template <class A, class B, enable_vec_expr<A> = 0, enable_vec_expr<B> = 0>
+VecSubExpr<A, B> operator-(A const& vec1, B const& vec2) { // оператор вычитания векторов
+    return {vec1, vec2};
+}
+
+
+template <class A, enable_vec_expr<A> = 0>
+VecScaleExpr<A> operator*(A const& vec, double num) { // оператор умножения вектора на число
+    return {vec, num};
+}
+
+
+template <class A, enable_vec_expr<A> = 0>
+VecScaleExpr<A> operator*(double num, A const& vec) { // оператор умножения вектора на число
+    return {vec, num};
+}
 
 
 double lc_norm(Vecr const& Vec); // l_inf норма
 
+
+template <class E, enable_vec_expr<E> = 0>
+double lc_norm(E const& expr) { // l_inf норма выражения без промежуточного вектора
+
+    double norm = 0.0;
+    const size_t sz = expr.size();
+    for (size_t i = 0; i < sz; ++i) {
+        norm = std::max(norm, std::abs(expr[i]));
+    }
+    return norm;
+
+}
+
+
+// операции на месте
+
+void axpy(double a, Vecr const& x, Vecr& y); // y += a * x
+
+
+void sub_into(Vecr const& vec1, Vecr const& vec2, Vecr& res); // res = vec1 - vec2
+
+
+double max_abs_diff(Vecr const& vec1, Vecr const& vec2); // lc_norm(vec1 - vec2) за один проход
+
 using Veci = std::vector<int>;
 using VecVeci = std::vector<Veci>;
 using Pairii = std::pair<int, int>;
 using VecPairii = std::vector<Pairii>;
 using VecVecPairii = std::vector<VecPairii>;
 
+// двумерные данные в одном непрерывном буфере
+
+constexpr size_t cache_line = 64; // размер кэш-линии в байтах
+
+
+// аллокатор, выравнивающий буфер по границе Align байт
+template <class T, size_t Align = cache_line>
+struct AlignedAllocator {
+
+    using value_type = T;
+    template <class U> struct rebind { using other = AlignedAllocator<U, Align>; };
+
+    AlignedAllocator() = default;
+    template <class U> AlignedAllocator(AlignedAllocator<U, Align> const&) {}
+
+    T* allocate(size_t n) {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Align)));
+    }
+    void deallocate(T* ptr, size_t) {
+        ::operator delete(ptr, std::align_val_t(Align));
+    }
+
+    template <class U> bool operator==(AlignedAllocator<U, Align> const&) const { return true; }
+    template <class U> bool operator!=(AlignedAllocator<U, Align> const&) const { return false; }
+
+};
+
+
+// представление строки или столбца сетки: ptr[0], ptr[step], ..., ptr[(n-1)*step]
+template <class T>
+struct Span {
+
+    T* ptr = nullptr;
+    size_t n = 0;
+    size_t step = 1;
+
+    T& operator[](size_t i) const { return ptr[i * step]; }
+    size_t size() const { return n; }
+    T* begin() const { return ptr; }          // только для step == 1
+    T* end() const { return ptr + n * step; } // только для step == 1
+
+};
+
+
+enum class GridLayout { RowMajor, ColMajor }; // по строкам / по столбцам
+
+
+// сетка rows x cols в непрерывном буфере, выровненном по кэш-линии; ведущие линии (строки при RowMajor,
+// столбцы при ColMajor) не короче кэш-линии добиваются хвостом до кратной ей длины, чтобы каждая
+// начиналась с кэш-линии; узкие линии лежат вплотную (иначе память и заполнение росли бы в разы)
+template <class T>
+class Grid {
+
+public:
+
+    Grid() = default;
+    Grid(size_t rows, size_t cols, T val = T(), GridLayout layout = GridLayout::RowMajor) {
+        assign(rows, cols, val, layout);
+    }
+
+    void assign(size_t rows, size_t cols, T val = T(), GridLayout layout = GridLayout::RowMajor) {
+        nr = rows;
+        nc = cols;
+        lay = layout;
+        const size_t line = (lay == GridLayout::RowMajor ? nc : nr);
+        const size_t per_line = std::max<size_t>(1, cache_line / sizeof(T));
+        ld = line < per_line ? line : (line + per_line - 1) / per_line * per_line;
+        buf.assign(ld * (lay == GridLayout::RowMajor ? nr : nc), val);
+    }
+
+    void fill(T val) { std::fill(buf.begin(), buf.end(), val); }
+
+    T& operator()(size_t i, size_t j) { return buf[index(i, j)]; }
+    T const& operator()(size_t i, size_t j) const { return buf[index(i, j)]; }
+
+    Span<T> row(size_t i) {
+        return lay == GridLayout::RowMajor ? Span<T>{buf.data() + i * ld, nc, 1} : Span<T>{buf.data() + i, nc, ld};
+    }
+    Span<T const> row(size_t i) const {
+        return lay == GridLayout::RowMajor ? Span<T const>{buf.data() + i * ld, nc, 1} : Span<T const>{buf.data() + i, nc, ld};
+    }
+    Span<T> col(size_t j) {
+        return lay == GridLayout::ColMajor ? Span<T>{buf.data() + j * ld, nr, 1} : Span<T>{buf.data() + j, nr, ld};
+    }
+    Span<T const> col(size_t j) const {
+        return lay == GridLayout::ColMajor ? Span<T const>{buf.data() + j * ld, nr, 1} : Span<T const>{buf.data() + j, nr, ld};
+    }
+
+    size_t rows() const { return nr; }
+    size_t cols() const { return nc; }
+    size_t stride() const { return ld; }
+    GridLayout layout() const { return lay; }
+    T* data() { return buf.data(); }
+    T const* data() const { return buf.data(); }
+
+private:
+
+    size_t index(size_t i, size_t j) const {
+        return lay == GridLayout::RowMajor ? i * ld + j : j * ld + i;
+    }
+
+    size_t nr = 0;   // количество строк
+    size_t nc = 0;   // количество столбцов
+    size_t ld = 0;   // шаг между ведущими линиями
+    GridLayout lay = GridLayout::RowMajor;
+    std::vector<T, AlignedAllocator<T>> buf;
+
+};
+
+
+// параллельный цикл f(0), ..., f(n-1): индексы раздаются потокам через атомарный счётчик,
+// threads <= 0 - по числу ядер
+template <class F>
+void parallel_for(int n, F const& f, int threads = 0) {
+
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    threads = std::max(1, std::min(threads, n));
+    if (threads == 1) {
+        for (int i = 0; i < n; ++i) f(i);
+        return;
+    }
+
+    std::atomic<int> next{0};
+    auto worker = [&]() {
+        for (int i = next.fetch_add(1); i < n; i = next.fetch_add(1)) f(i);
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(threads - 1);
+    for (int k = 1; k < threads; ++k) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+
+}
+
+
+// пул потоков для повторяющихся параллельных циклов: потоки создаются один раз, run(n, f) раздаёт
+// индексы как parallel_for и возвращается, когда выполнены все f(i); вызывающий поток тоже работает
+class ThreadPool {
+
+public:
+
+    explicit ThreadPool(int threads = 0) {
+        if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+        for (int k = 1; k < threads; ++k) pool.emplace_back([this]() { loop(); });
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = true;
+        }
+        wake.notify_all();
+        for (auto& th : pool) th.join();
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator=(ThreadPool const&) = delete;
+
+    int size() const { return (int)pool.size() + 1; }
+
+    void run(int n, std::function<void(int)> const& f) {
+        if (pool.empty() || n <= 1) {
+            for (int i = 0; i < n; ++i) f(i);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            job = &f;
+            count = n;
+            next.store(0);
+            active = (int)pool.size();
+            ++generation;
+        }
+        wake.notify_all();
+        work();
+        std::unique_lock<std::mutex> lock(mtx);
+        done.wait(lock, [this]() { return active == 0; });
+        job = nullptr;
+    }
+
+private:
+
+    void work() {
+        for (int i = next.fetch_add(1); i < count; i = next.fetch_add(1)) (*job)(i);
+    }
+
+    void loop() {
+        size_t seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                wake.wait(lock, [&]() { return stop || generation != seen; });
+                if (stop) return;
+                seen = generation;
+            }
+            work();
+            std::lock_guard<std::mutex> lock(mtx);
+            if (--active == 0) done.notify_one();
+        }
+    }
+
+    std::vector<std::thread> pool;
+    std::mutex mtx;
+    std::condition_variable wake, done;
+    std::function<void(int)> const* job = nullptr;
+    int count = 0;
+    std::atomic<int> next{0};
+    int active = 0;          // потоки пула, ещё не закончившие текущий цикл
+    size_t generation = 0;   // номер цикла: потоки просыпаются на новом
+    bool stop = false;
+
+};
+
+
+// отображение файла в память (POSIX mmap): для чтения - весь существующий файл,
+// для записи - файл создаётся (перезаписывается) заданного размера; ошибки - std::runtime_error
+class MappedFile {
+
+public:
+
+    explicit MappedFile(std::string const& path);       // только чтение
+    MappedFile(std::string const& path, size_t bytes); // чтение и запись
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator=(MappedFile const&) = delete;
+
+    void* data() const { return ptr; }
+    size_t size() const { return bytes; }
+
+    // вернуть ядру страницы диапазона (изменения сохраняются в файле), чтобы резидентная память не росла с файлом
+    void release(size_t offset, size_t len);
+
+private:
+
+    void* ptr = nullptr;
+    size_t bytes = 0;
+    int fd = -1;
+    bool writable = false;
+
+};
+
+
+using Matrix = Grid<double>; // синоним для вещественной матрицы
+using Gridi = Grid<int>;     // синоним для целочисленной матрицы
+
 
 
 #endif
\ No newline at end of file
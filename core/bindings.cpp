@@ -1,11 +1,48 @@
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
 
 #include "rhythmic_delivery.h"
 #include "pcplp.h"
 
 namespace py = pybind11;
 
+using ArrayR = py::array_t<double, py::array::c_style | py::array::forcecast>;
+using ArrayI = py::array_t<int32_t, py::array::c_style | py::array::forcecast>;
+
+
+// сборка пакета из NumPy: p - массив K x n, V0/minV/maxV - массивы длины K
+static DeliveryBatch make_batch(ArrayR const& p, ArrayR const& V0, ArrayR const& minV, ArrayR const& maxV) {
+
+    if (p.ndim() != 2) throw std::invalid_argument("p must be a 2D array (products x tacts)");
+    DeliveryBatch b;
+    b.K = (int)p.shape(0);
+    b.n = (int)p.shape(1);
+    if (V0.size() != b.K || minV.size() != b.K || maxV.size() != b.K)
+        throw std::invalid_argument("V0, minV, maxV must have one value per product");
+
+    b.p.assign(p.data(), p.data() + p.size());
+    b.V0.assign(V0.data(), V0.data() + b.K);
+    b.minV.assign(minV.data(), minV.data() + b.K);
+    b.maxV.assign(maxV.data(), maxV.data() + b.K);
+    return b;
+
+}
+
+
+static py::dict batch_to_dict(DeliveryBatchResult const& r) {
+
+    const std::vector<py::ssize_t> shape{r.K, r.n};
+    py::dict d;
+    d["x"] = py::array_t<double>(shape, r.x.data());
+    d["V"] = py::array_t<double>(shape, r.V.data());
+    d["ok"] = py::array_t<bool>(r.K, reinterpret_cast<const bool*>(r.ok.data()));
+    d["Mp"] = py::array_t<double>(r.K, r.Mp.data());
+    d["iters"] = py::array_t<int>(r.K, r.iters.data());
+    return d;
+
+}
+
 PYBIND11_MODULE(calc_module, m) {
     m.doc() =  "Calculation module (C++/pybind11)";
 
@@ -24,15 +61,171 @@ PYBIND11_MODULE(calc_module, m) {
              py::arg("Mp"), py::arg("maxIter"), py::arg("iters"))
         .def_readonly("Mp", &UniformityIterResult::Mp)
         .def_readonly("maxIter", &UniformityIterResult::maxIter)
-        .def_readonly("iters", &UniformityIterResult::iters);
+        .def_readonly("iters", &UniformityIterResult::iters)
+        .def_readonly("itersSaved", &UniformityIterResult::itersSaved)
+        .def_readonly("seconds", &UniformityIterResult::seconds)
+        .def_readonly("objective", &UniformityIterResult::objective)
+        .def_readonly("pgNorm", &UniformityIterResult::pgNorm)
+        .def_readonly("maxViolation", &UniformityIterResult::maxViolation)
+        .def_readonly("clamped", &UniformityIterResult::clamped)
+        .def_readonly("histIter", &UniformityIterResult::histIter)
+        .def_readonly("histSeconds", &UniformityIterResult::histSeconds)
+        .def_readonly("histObjective", &UniformityIterResult::histObjective)
+        .def_readonly("histPgNorm", &UniformityIterResult::histPgNorm)
+        .def_readonly("histOutside", &UniformityIterResult::histOutside);
 
 
-    m.def("solve_uniform_pg", &solve_rhythmic_delivery_uniform_pg,
+    py::class_<IterOptions>(m, "IterOptions")
+        .def(py::init<>())
+        .def_readwrite("x0", &IterOptions::x0)
+        .def_readwrite("y0", &IterOptions::y0)
+        .def_readwrite("eps", &IterOptions::eps)
+        .def_readwrite("maxIter", &IterOptions::maxIter)
+        .def_readwrite("measureSaved", &IterOptions::measureSaved)
+        .def_readwrite("historyEvery", &IterOptions::historyEvery);
+
+    m.def("solve_uniform_pg", py::overload_cast<const Vecr&, double, double, double>(&solve_rhythmic_delivery_uniform_pg),
             py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"));
+
+    m.def("solve_uniform_pg", py::overload_cast<const Vecr&, double, double, double, const IterOptions&>(&solve_rhythmic_delivery_uniform_pg),
+            py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("options"));
+
+    m.def("solve_uniform_fista", py::overload_cast<const Vecr&, double, double, double>(&solve_rhythmic_delivery_uniform_fista),
+            py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"));
+
+    m.def("solve_uniform_fista", py::overload_cast<const Vecr&, double, double, double, const IterOptions&>(&solve_rhythmic_delivery_uniform_fista),
+            py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("options"));
+
+
+    py::class_<WeightedDeliveryResult, DeliveryResult>(m, "WeightedDeliveryResult")
+        .def(py::init<>())
+        .def_readonly("beta", &WeightedDeliveryResult::beta)
+        .def_readonly("uniformity", &WeightedDeliveryResult::uniformity)
+        .def_readonly("storage", &WeightedDeliveryResult::storage)
+        .def_readonly("objective", &WeightedDeliveryResult::objective)
+        .def_readonly("iters", &WeightedDeliveryResult::iters);
+
+    m.def("solve_weighted", &solve_rhythmic_delivery_weighted,
+            py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("beta"),
+            py::arg("options") = IterOptions{});
+
+    m.def("sweep_weighted", &sweep_rhythmic_delivery_weighted,
+            py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("betas"),
+            py::arg("options") = IterOptions{}, py::call_guard<py::gil_scoped_release>());
     
     m.def("solve_direct", &solve_rhythmic_delivery_bounds_direct,
         py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"));
 
+    py::class_<DeliveryProblem>(m, "DeliveryProblem")
+        .def(py::init<>())
+        .def_readwrite("p", &DeliveryProblem::p)
+        .def_readwrite("V0", &DeliveryProblem::V0)
+        .def_readwrite("minV", &DeliveryProblem::minV)
+        .def_readwrite("maxV", &DeliveryProblem::maxV)
+        .def_readwrite("xmin", &DeliveryProblem::xmin)
+        .def_readwrite("xmax", &DeliveryProblem::xmax)
+        .def_readwrite("w", &DeliveryProblem::w)
+        .def_readwrite("target", &DeliveryProblem::target)
+        .def_readwrite("cost", &DeliveryProblem::cost)
+        .def_readwrite("hold", &DeliveryProblem::hold);
+
+    py::class_<DeliveryQPResult, DeliveryResult>(m, "DeliveryQPResult")
+        .def(py::init<>())
+        .def_readonly("objective", &DeliveryQPResult::objective)
+        .def_readonly("level", &DeliveryQPResult::level);
+
+    m.def("solve_general", &solve_rhythmic_delivery_general, py::arg("problem"),
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<DeliverySensitivity, DeliveryQPResult>(m, "DeliverySensitivity")
+        .def(py::init<>())
+        .def_readonly("atMin", &DeliverySensitivity::atMin)
+        .def_readonly("atMax", &DeliverySensitivity::atMax)
+        .def_readonly("multiplier", &DeliverySensitivity::multiplier)
+        .def_readonly("dObj_dp", &DeliverySensitivity::dObj_dp)
+        .def_readonly("dObj_dminV", &DeliverySensitivity::dObj_dminV)
+        .def_readonly("dObj_dmaxV", &DeliverySensitivity::dObj_dmaxV)
+        .def_readonly("dObj_dV0", &DeliverySensitivity::dObj_dV0);
+
+    m.def("solve_sensitivity", &solve_rhythmic_delivery_sensitivity, py::arg("problem"),
+          py::call_guard<py::gil_scoped_release>());
+
+    m.def("solve_uniform_batch",
+        [](ArrayR p, ArrayR V0, ArrayR minV, ArrayR maxV, int threads) {
+            DeliveryBatch b = make_batch(p, V0, minV, maxV);
+            DeliveryBatchResult r;
+            {
+                py::gil_scoped_release release;
+                r = solve_rhythmic_delivery_uniform_batch(b, threads);
+            }
+            return batch_to_dict(r);
+        },
+        py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("threads") = 0);
+
+    m.def("solve_direct_batch",
+        [](ArrayR p, ArrayR V0, ArrayR minV, ArrayR maxV, int threads) {
+            DeliveryBatch b = make_batch(p, V0, minV, maxV);
+            DeliveryBatchResult r;
+            {
+                py::gil_scoped_release release;
+                r = solve_rhythmic_delivery_bounds_direct_batch(b, threads);
+            }
+            return batch_to_dict(r);
+        },
+        py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("threads") = 0);
+
+    py::class_<SharedWarehouseProblem>(m, "SharedWarehouseProblem")
+        .def(py::init<>())
+        .def_readwrite("products", &SharedWarehouseProblem::products)
+        .def_readwrite("maxVTotal", &SharedWarehouseProblem::maxVTotal);
+
+    py::class_<SharedWarehouseResult>(m, "SharedWarehouseResult")
+        .def(py::init<>())
+        .def_readonly("products", &SharedWarehouseResult::products)
+        .def_readonly("price", &SharedWarehouseResult::price)
+        .def_readonly("totalV", &SharedWarehouseResult::totalV)
+        .def_readonly("maxExcess", &SharedWarehouseResult::maxExcess)
+        .def_readonly("iters", &SharedWarehouseResult::iters)
+        .def_readonly("ok", &SharedWarehouseResult::ok);
+
+    m.def("solve_shared_warehouse", &solve_shared_warehouse,
+          py::arg("problem"), py::arg("maxIter") = 500, py::arg("tol") = 1e-6, py::arg("threads") = 0,
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<MappedDeliveryResult>(m, "MappedDeliveryResult")
+        .def(py::init<>())
+        .def_readonly("n", &MappedDeliveryResult::n)
+        .def_readonly("Mp", &MappedDeliveryResult::Mp)
+        .def_readonly("objective", &MappedDeliveryResult::objective)
+        .def_readonly("ok", &MappedDeliveryResult::ok);
+
+    m.def("solve_uniform_mapped", &solve_rhythmic_delivery_uniform_mapped,
+          py::arg("p_path"), py::arg("x_path"), py::arg("V_path"), py::arg("V0"), py::arg("minV"), py::arg("maxV"),
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<LotDeliveryResult, DeliveryResult>(m, "LotDeliveryResult")
+        .def(py::init<>())
+        .def_readonly("lots", &LotDeliveryResult::lots)
+        .def_readonly("objective", &LotDeliveryResult::objective)
+        .def_readonly("Mp", &LotDeliveryResult::Mp);
+
+    m.def("solve_lots", &solve_rhythmic_delivery_lots,
+          py::arg("p"), py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("lot"),
+          py::call_guard<py::gil_scoped_release>());
+
+    py::class_<RhythmicDeliveryStream>(m, "RhythmicDeliveryStream")
+        .def(py::init<double, double, double, int, int>(),
+             py::arg("V0"), py::arg("minV"), py::arg("maxV"), py::arg("maxIterPerUpdate") = 200,
+             py::arg("maxHorizon") = 256)
+        .def("push", &RhythmicDeliveryStream::push, py::arg("p"))
+        .def("revise", &RhythmicDeliveryStream::revise, py::arg("t"), py::arg("p"))
+        .def("solve", &RhythmicDeliveryStream::solve)
+        .def("advance", &RhythmicDeliveryStream::advance)
+        .def_property_readonly("window", &RhythmicDeliveryStream::window)
+        .def_property_readonly("horizon", &RhythmicDeliveryStream::horizon)
+        .def_property_readonly("storage", &RhythmicDeliveryStream::storage)
+        .def_property_readonly("committed", &RhythmicDeliveryStream::committed);
+
 
     py::class_<Schedule>(m, "Schedule")
         .def(py::init<>())
@@ -40,8 +233,156 @@ PYBIND11_MODULE(calc_module, m) {
         .def_readonly("finish", &Schedule::finish)
         .def_readonly("cmax", &Schedule::cmax);
 
-     m.def("solve_pcplp", &solve_PCPLP,
+    py::enum_<DecoderKind>(m, "DecoderKind")
+        .value("Serial", DecoderKind::Serial)
+        .value("Parallel", DecoderKind::Parallel)
+        .value("Best", DecoderKind::Best);
+
+    py::enum_<GAEngine>(m, "GAEngine")
+        .value("Permutation", GAEngine::Permutation)
+        .value("RandomKey", GAEngine::RandomKey);
+
+    py::enum_<Objective>(m, "Objective")
+        .value("Makespan", Objective::Makespan)
+        .value("SquaredUsage", Objective::SquaredUsage)
+        .value("MaxPeak", Objective::MaxPeak)
+        .value("Overload", Objective::Overload);
+
+    py::class_<DurationModel>(m, "DurationModel")
+        .def(py::init<>())
+        .def(py::init([](Veci lo, Veci hi) { return DurationModel{std::move(lo), std::move(hi)}; }),
+             py::arg("lo"), py::arg("hi"))
+        .def_readwrite("lo", &DurationModel::lo)
+        .def_readwrite("hi", &DurationModel::hi);
+
+    py::class_<SolveOptions>(m, "SolveOptions")
+        .def(py::init<>())
+        .def_readwrite("decoder", &SolveOptions::decoder)
+        .def_readwrite("engine", &SolveOptions::engine)
+        .def_readwrite("ruleShare", &SolveOptions::ruleShare)
+        .def_readwrite("regretAlpha", &SolveOptions::regretAlpha)
+        .def_readwrite("checkpointPath", &SolveOptions::checkpointPath)
+        .def_readwrite("checkpointEvery", &SolveOptions::checkpointEvery)
+        .def_readwrite("resumeFrom", &SolveOptions::resumeFrom)
+        .def_readwrite("durations", &SolveOptions::durations)
+        .def_readwrite("robustScenarios", &SolveOptions::robustScenarios)
+        .def_readwrite("robustQuantile", &SolveOptions::robustQuantile)
+        .def_readwrite("robustSeed", &SolveOptions::robustSeed)
+        .def_readwrite("objective", &SolveOptions::objective)
+        .def_readwrite("deadline", &SolveOptions::deadline)
+        .def_readwrite("deadlinePenalty", &SolveOptions::deadlinePenalty)
+        .def_readwrite("overloadLevel", &SolveOptions::overloadLevel)
+        .def_readwrite("timeLimit", &SolveOptions::timeLimit);
+
+    py::class_<Instance>(m, "Instance")
+        .def(py::init<>())
+        .def_readwrite("N", &Instance::N)
+        .def_readwrite("M", &Instance::M)
+        .def_readwrite("dur", &Instance::dur)
+        .def_readwrite("rel", &Instance::rel)
+        .def_readwrite("cap", &Instance::cap)
+        .def_readwrite("calendars", &Instance::calendars)
+        .def_readwrite("demands", &Instance::demands)
+        .def_readwrite("preds", &Instance::preds)
+        .def_readonly("succs", &Instance::succs)
+        .def_readonly("topo", &Instance::topo)
+        .def_readonly("head", &Instance::head)
+        .def_readonly("tail", &Instance::tail);
+
+    m.def("preprocess_instance", [](Instance inst) { preprocess_instance(inst); return inst; }, py::arg("instance"));
+    m.def("lower_bound_cmax", &lower_bound_cmax, py::arg("instance"));
+
+    py::enum_<PriorityRule>(m, "PriorityRule")
+        .value("LFT", PriorityRule::LFT)
+        .value("LST", PriorityRule::LST)
+        .value("MTS", PriorityRule::MTS)
+        .value("GRPW", PriorityRule::GRPW)
+        .value("RSM", PriorityRule::RSM);
+
+    m.def("priority_rule_perm", [](Instance const& inst, PriorityRule rule, py::object seed, double alpha) {
+              if (seed.is_none()) return priority_rule_perm(inst, rule);
+              std::mt19937 rng(seed.cast<unsigned>());
+              return priority_rule_perm(inst, rule, &rng, alpha);
+          },
+          py::arg("instance"), py::arg("rule"), py::arg("seed") = py::none(), py::arg("alpha") = 1.0);
+
+     m.def("solve_pcplp_instance", py::overload_cast<Instance, SolveOptions const&>(&solve_PCPLP),
+          py::arg("instance"), py::arg("options") = SolveOptions{});
+
+     m.def("solve_pcplp", py::overload_cast<int, int, Veci, Veci, Veci, VecVecPairii, VecVeci>(&solve_PCPLP),
           py::arg("N"), py::arg("M"),
           py::arg("dur"), py::arg("rel"), py::arg("cap"), py::arg("demands"), py::arg("preds"));
 
+     m.def("solve_pcplp", py::overload_cast<int, int, Veci, Veci, Veci, VecVecPairii, VecVeci, SolveOptions const&>(&solve_PCPLP),
+          py::arg("N"), py::arg("M"),
+          py::arg("dur"), py::arg("rel"), py::arg("cap"), py::arg("demands"), py::arg("preds"), py::arg("options"));
+
+
+
+    // пакетное декодирование: perms - массив K x N перестановок; возвращает cmax (K) и, по запросу, start (K x N)
+    m.def("decode_batch",
+        [](Instance const& inst, ArrayI perms, bool withStarts, DecoderKind kind, int threads) {
+            if (perms.ndim() != 2 || perms.shape(1) != inst.N)
+                throw std::invalid_argument("perms must be a 2D array (permutations x jobs)");
+            const int K = (int)perms.shape(0);
+            Veci flat(perms.data(), perms.data() + perms.size());
+            DecodeBatchResult r;
+            {
+                py::gil_scoped_release release;
+                r = decode_batch(inst, flat, K, withStarts, kind, threads);
+            }
+            py::dict d;
+            d["cmax"] = py::array_t<int>(r.K, r.cmax.data());
+            if (withStarts) d["start"] = py::array_t<int>(std::vector<py::ssize_t>{r.K, r.N}, r.start.data());
+            return d;
+        },
+        py::arg("instance"), py::arg("perms"), py::arg("withStarts") = false,
+        py::arg("decoder") = DecoderKind::Serial, py::arg("threads") = 0);
+
+    py::class_<RobustnessOptions>(m, "RobustnessOptions")
+        .def(py::init<>())
+        .def_readwrite("scenarios", &RobustnessOptions::scenarios)
+        .def_readwrite("seed", &RobustnessOptions::seed)
+        .def_readwrite("levels", &RobustnessOptions::levels)
+        .def_readwrite("decoder", &RobustnessOptions::decoder)
+        .def_readwrite("threads", &RobustnessOptions::threads);
+
+    py::class_<RobustnessResult>(m, "RobustnessResult")
+        .def_readonly("cmax", &RobustnessResult::cmax)
+        .def_readonly("nominal", &RobustnessResult::nominal)
+        .def_readonly("mean", &RobustnessResult::mean)
+        .def_readonly("stddev", &RobustnessResult::stddev)
+        .def_readonly("levels", &RobustnessResult::levels)
+        .def_readonly("quantiles", &RobustnessResult::quantiles);
+
+     m.def("simulate_robustness", &simulate_robustness,
+          py::arg("instance"), py::arg("perm"), py::arg("durations"), py::arg("options") = RobustnessOptions{},
+          py::call_guard<py::gil_scoped_release>());
+
+    py::enum_<PortfolioEngine>(m, "PortfolioEngine")
+        .value("GA", PortfolioEngine::GA)
+        .value("SA", PortfolioEngine::SA)
+        .value("Sampler", PortfolioEngine::Sampler);
+
+    py::class_<PortfolioOptions>(m, "PortfolioOptions")
+        .def(py::init<>())
+        .def_readwrite("seconds", &PortfolioOptions::seconds)
+        .def_readwrite("useGA", &PortfolioOptions::useGA)
+        .def_readwrite("useSA", &PortfolioOptions::useSA)
+        .def_readwrite("useSampler", &PortfolioOptions::useSampler)
+        .def_readwrite("decoder", &PortfolioOptions::decoder)
+        .def_readwrite("seed", &PortfolioOptions::seed);
+
+    py::class_<PortfolioResult>(m, "PortfolioResult")
+        .def_readonly("schedule", &PortfolioResult::schedule)
+        .def_readonly("winner", &PortfolioResult::winner)
+        .def_readonly("engineCmax", &PortfolioResult::engineCmax)
+        .def_readonly("launched", &PortfolioResult::launched)
+        .def_readonly("evaluations", &PortfolioResult::evaluations)
+        .def_readonly("lowerBound", &PortfolioResult::lowerBound);
+
+     m.def("solve_pcplp_portfolio", &solve_PCPLP_portfolio,
+          py::arg("instance"), py::arg("options") = PortfolioOptions{},
+          py::call_guard<py::gil_scoped_release>());
+
 }
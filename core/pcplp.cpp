@@ -1,5 +1,48 @@
 #include "pcplp.h"
 
+#include <limits>
+#include <functional>
+#include <cstring>
+#include <stdexcept>
+#include <bitset>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <chrono>
+#include <thread>
+#include <exception>
+
+#ifdef _WIN32
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+// ограничение времени поиска: seconds <= 0 - без ограничения
+class TimeLimit {
+
+public:
+
+    explicit TimeLimit(double seconds)
+        : on(seconds > 0),
+          until(std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                                      std::chrono::duration<double>(std::max(0.0, seconds)))) {}
+
+    bool expired() const { return on && std::chrono::steady_clock::now() >= until; }
+
+private:
+
+    bool on;
+    std::chrono::steady_clock::time_point until;
+
+};
+
 
 // реализация решения задачи календарного планирования с ограниченными ресурсами - генетический алгоритм
 Schedule solve_PCPLP(int N,           
@@ -9,6 +52,19 @@ Schedule solve_PCPLP(int N,
                  Veci cap,          
                  VecVecPairii demands,
                  VecVeci preds)
+{
+    return solve_PCPLP(N, M, dur, rel, cap, demands, preds, SolveOptions{});
+}
+
+
+Schedule solve_PCPLP(int N,
+                 int M,
+                 Veci dur,
+                 Veci rel,
+                 Veci cap,
+                 VecVecPairii demands,
+                 VecVeci preds,
+                 SolveOptions const& opt)
 {
     Instance inst;
     inst.N = N;
@@ -18,7 +74,21 @@ Schedule solve_PCPLP(int N,
     inst.cap = cap;
     inst.demands = demands;
     inst.preds = preds;
-    build_succs(inst); // построим последователей(у работ также есть предшественники) - последующие работы
+    return solve_PCPLP(std::move(inst), opt);
+}
+
+
+Schedule solve_PCPLP(Instance inst, SolveOptions const& opt)
+{
+    DecoderWS ws;
+    return solve_PCPLP(std::move(inst), opt, ws);
+}
+
+
+Schedule solve_PCPLP(Instance inst, SolveOptions const& opt, DecoderWS& ws)
+{
+    const int N = inst.N;
+    preprocess_instance(inst); // последователи, проверка циклов, редукция дуг, головы и хвосты
 
     std::random_device rd;  // рандомный сид
     std::mt19937 rng(rd()); // генератор случайных чисел
@@ -30,33 +100,80 @@ Schedule solve_PCPLP(int N,
     const int TOURN_K = 3;     // количество особей, участвующих в турнирном отборе
     const double PCROSS = 0.9; // вероятность скрещивания
     const double PMUT = 0.2;   // вероятность мутации
-    DecoderWS ws;
     init_ws(inst, ws);
+    ws.kind = opt.decoder;
+
+    if ((!opt.resumeFrom.empty() || !opt.checkpointPath.empty()) && opt.engine != GAEngine::Permutation)
+        throw std::invalid_argument("checkpoints are supported for the permutation engine only");
+
+    // устойчивая цель: особи сравниваются по квантилю cmax на общих сценариях, ответ - номинальное расписание
+    // сценарии живут только в этом вызове: при любом выходе рабочая область от них отвязывается
+    ScenarioSet scenarios;
+    struct DetachScenarios {
+        DecoderWS& ws;
+        ~DetachScenarios() { ws.scenarios = nullptr; }
+    } detach{ws};
+    if (opt.robustScenarios > 0) {
+        scenarios = sample_scenarios(inst, opt.durations, opt.robustScenarios, opt.robustSeed);
+        attach_scenarios(inst, scenarios, opt.robustQuantile, ws);
+    }
 
-    Individs pop = init_population(inst, POP, rng, 0.7, ws); // сгенерируем начальную популяцию
+    // цели выравнивания: отбор по показателям профиля, накапливаемым декодером
+    if (opt.objective != Objective::Makespan) {
+        if (opt.engine != GAEngine::Permutation || opt.robustScenarios > 0)
+            throw std::invalid_argument("leveling objectives are supported for the nominal permutation engine only");
+        set_objective(inst, opt.objective, opt.deadline, opt.deadlinePenalty, opt.overloadLevel, ws);
+    }
 
-    auto best_it = std::min_element(pop.begin(), pop.end(), better);
-    Individ best = *best_it; // лучший индивид
+    if (opt.engine == GAEngine::RandomKey) {
+        BRKGAParams prm;
+        prm.POP = POP;
+        prm.GEN = GEN;
+        prm.ruleShare = opt.ruleShare;
+        prm.regretAlpha = opt.regretAlpha;
+        prm.timeLimit = opt.timeLimit;
+        Individ bestKeys = run_BRKGA(inst, prm, rng, ws);
+        return decode(inst, bestKeys.perm, ws);
+    }
 
-    int stall = 0; // для ранней остановки - количество неулучшаемых поколений
+    GAState st;
+    if (!opt.resumeFrom.empty()) {
+        st = load_checkpoint(opt.resumeFrom, inst); // популяция, лучшая особь, счётчики и генератор
+        std::istringstream is(st.rng);
+        is >> rng;
+        for (auto& ind : st.pop) evaluate_individ(inst, ind, ws); // fitness в файле не хранится
+        evaluate_individ(inst, st.best, ws);
+    } else {
+        st.pop = init_population(inst, POP, rng, 0.7, ws, opt.ruleShare, opt.regretAlpha); // сгенерируем начальную популяцию
+        st.best = *std::min_element(st.pop.begin(), st.pop.end(), better); // лучший индивид
+    }
+    const bool checkpoints = !opt.checkpointPath.empty() && opt.checkpointEvery > 0;
+    const TimeLimit limit(opt.timeLimit);
 
-    for (int g = 1; g <= GEN; ++g) {
+    // st.stall - для ранней остановки - количество неулучшаемых поколений
+    for (int g = st.generation + 1; g <= GEN && st.stall < 50 && !limit.expired(); ++g) { // быстрое завершение, если нет улучшений
 
-        pop = next_generation(inst, pop, ELITE, TOURN_K, PCROSS, PMUT, rng, ws); // сгенерируем новое поколение
+        st.pop = next_generation(inst, st.pop, ELITE, TOURN_K, PCROSS, PMUT, rng, ws); // сгенерируем новое поколение
 
-        Individ curBest = *std::min_element(pop.begin(), pop.end(), better); // лучший индивид в новом поколении
-        if (curBest.cmax < best.cmax) {
-            best = curBest;
-            stall = 0;
+        Individ curBest = *std::min_element(st.pop.begin(), st.pop.end(), better); // лучший индивид в новом поколении
+        if (better(curBest, st.best)) {
+            st.best = curBest;
+            st.stall = 0;
         } else {
-            ++stall;
+            ++st.stall;
         }
+        st.generation = g;
 
-        if (stall >= 50) break; // быстрое завершение, если нет улучшений
+        if (checkpoints && g % opt.checkpointEvery == 0) {
+            std::ostringstream os;
+            os << rng;
+            st.rng = os.str();
+            save_checkpoint(opt.checkpointPath, inst, st);
+        }
     }
 
 
-    return serial_decode_SGS(inst, best.perm, ws);
+    return decode(inst, st.best.perm, ws);
 
 }
 //
@@ -78,6 +195,131 @@ void build_succs(Instance& inst)
 //
 
 
+// реализация предобработки
+void preprocess_instance(Instance& inst)
+{
+    const int N = inst.N;
+    if ((int)inst.preds.size() != N || (int)inst.dur.size() != N || (int)inst.rel.size() != N
+        || (int)inst.demands.size() != N || (int)inst.cap.size() != inst.M)
+        throw std::invalid_argument("dur, rel, demands and preds must have N entries, cap - M entries");
+    if (!inst.calendars.empty() && (int)inst.calendars.size() != inst.M)
+        throw std::invalid_argument("calendars must be empty or given for every resource");
+    for (int j = 0; j < N; ++j)
+        if (inst.dur[j] < 0 || inst.rel[j] < 0)
+            throw std::invalid_argument("negative duration or release of job " + std::to_string(j));
+    for (int m = 0; m < inst.M; ++m)
+        if (inst.cap[m] < 0) throw std::invalid_argument("negative capacity of resource " + std::to_string(m));
+
+    // с календарём работа обязана поместиться в последний (бесконечный) отрезок, до него мощность может быть
+    // и меньше потребности - такие отрезки декодер пропускает
+    Veci finalCap = inst.cap;
+    for (int m = 0; m < (int)inst.calendars.size(); ++m)
+        if (!inst.calendars[m].empty()) finalCap[m] = inst.calendars[m].back().second;
+    for (int j = 0; j < N; ++j)
+        for (auto [m, qty] : inst.demands[j])
+            if (m < 0 || m >= inst.M || qty < 0 || qty > finalCap[m])
+                throw std::invalid_argument("invalid demand of job " + std::to_string(j) + " for resource " + std::to_string(m));
+    for (int j = 0; j < N; ++j)
+        for (int p : inst.preds[j])
+            if (p < 0 || p >= N || p == j)
+                throw std::invalid_argument("invalid predecessor " + std::to_string(p) + " of job " + std::to_string(j));
+
+    build_succs(inst);
+
+    // топологический порядок (Кан); непросмотренные работы лежат на цикле или после него
+    Veci indeg(N);
+    for (int j = 0; j < N; ++j) indeg[j] = (int)inst.preds[j].size();
+    inst.topo.clear();
+    inst.topo.reserve(N);
+    for (int j = 0; j < N; ++j) if (indeg[j] == 0) inst.topo.push_back(j);
+    for (size_t k = 0; k < inst.topo.size(); ++k)
+        for (int v : inst.succs[inst.topo[k]])
+            if (--indeg[v] == 0) inst.topo.push_back(v);
+    if ((int)inst.topo.size() < N) {
+        // у непросмотренной работы есть непросмотренный предшественник: идём по ним назад до повтора
+        int j = 0;
+        while (indeg[j] == 0) ++j;
+        Veci step(N, -1); // номер шага, на котором работа встретилась
+        Veci path;
+        while (step[j] < 0) {
+            step[j] = (int)path.size();
+            path.push_back(j);
+            for (int p : inst.preds[j])
+                if (indeg[p] > 0) {
+                    j = p;
+                    break;
+                }
+        }
+        // путь шёл против дуг: цикл в порядке предшествования - с конца пути до повтора
+        std::string cycle = std::to_string(j);
+        for (int k = (int)path.size() - 1; k >= step[j]; --k) cycle += " -> " + std::to_string(path[k]);
+        throw std::invalid_argument("precedence graph has a cycle: " + cycle);
+    }
+
+    // транзитивная редукция: обходим работы с конца порядка, последователей - по возрастанию номера
+    // в порядке; дуга u -> v лишняя, если v достижима из уже оставленного последователя (битовые множества)
+    Veci ord(N);
+    for (int k = 0; k < N; ++k) ord[inst.topo[k]] = k;
+    const size_t words = ((size_t)N + 63) / 64;
+    std::vector<uint64_t> reach((size_t)N * words, 0);
+    VecVeci keptSuccs(N);
+    for (int k = N - 1; k >= 0; --k) {
+        const int u = inst.topo[k];
+        Veci sc = inst.succs[u];
+        std::sort(sc.begin(), sc.end(), [&](int a, int b) { return ord[a] < ord[b]; });
+        sc.erase(std::unique(sc.begin(), sc.end()), sc.end());
+        uint64_t* ru = &reach[(size_t)u * words];
+        for (int v : sc) {
+            if (ru[v / 64] >> (v % 64) & 1) continue;
+            keptSuccs[u].push_back(v);
+            const uint64_t* rv = &reach[(size_t)v * words];
+            for (size_t w = 0; w < words; ++w) ru[w] |= rv[w];
+            ru[v / 64] |= uint64_t(1) << (v % 64);
+        }
+    }
+    inst.succs.swap(keptSuccs);
+    for (auto& pr : inst.preds) pr.clear();
+    for (int u = 0; u < N; ++u)
+        for (int v : inst.succs[u]) inst.preds[v].push_back(u);
+
+    // головы - прямым проходом, хвосты - обратным
+    inst.head.assign(N, 0);
+    inst.tail.assign(N, 0);
+    for (int u : inst.topo) {
+        inst.head[u] = std::max(inst.head[u], inst.rel[u]);
+        for (int v : inst.succs[u]) inst.head[v] = std::max(inst.head[v], inst.head[u] + inst.dur[u]);
+    }
+    for (int k = N - 1; k >= 0; --k) {
+        const int u = inst.topo[k];
+        for (int v : inst.succs[u]) inst.tail[u] = std::max(inst.tail[u], inst.dur[v] + inst.tail[v]);
+    }
+}
+//
+
+
+// реализация нижней оценки
+int lower_bound_cmax(const Instance& inst)
+{
+    int lb = 0;
+    for (int j = 0; j < inst.N; ++j) {
+        const int h = inst.head.empty() ? inst.rel[j] : inst.head[j];
+        const int t = inst.tail.empty() ? 0 : inst.tail[j];
+        lb = std::max(lb, h + inst.dur[j] + t);
+    }
+
+    // работа ресурса не меньше суммарной потребности, делённой на мощность (для календарей оценка не строится)
+    if (inst.calendars.empty()) {
+        std::vector<long long> work(inst.M, 0);
+        for (int j = 0; j < inst.N; ++j)
+            for (auto [m, qty] : inst.demands[j]) work[m] += (long long)qty * inst.dur[j];
+        for (int m = 0; m < inst.M; ++m)
+            if (inst.cap[m] > 0) lb = std::max(lb, (int)((work[m] + inst.cap[m] - 1) / inst.cap[m]));
+    }
+    return lb;
+}
+//
+
+
 //  
 Veci make_random_perm(
                       int N,            // количество работ
@@ -134,26 +376,138 @@ Veci make_random_topo_perm(
 //
 
 
+// реализация правил приоритета
+Veci priority_rule_perm(const Instance& inst, PriorityRule rule, std::mt19937* rng, double alpha)
+{
+    const int N = inst.N;
+    if ((int)inst.head.size() != N || (int)inst.tail.size() != N)
+        throw std::invalid_argument("priority rules need preprocess_instance");
+
+    // горизонт - критический путь; позднее окончание LF = T - tail, позднее начало LS = LF - dur
+    int T = 0;
+    for (int j = 0; j < N; ++j) T = std::max(T, inst.head[j] + inst.dur[j] + inst.tail[j]);
+
+    // статический приоритет, больше - лучше
+    Vecr score(N, 0.0);
+    if (rule == PriorityRule::MTS) {
+        // число всех последователей: битовые множества достижимости с конца топологического порядка
+        const size_t words = ((size_t)N + 63) / 64;
+        std::vector<uint64_t> reach((size_t)N * words, 0);
+        for (int k = N - 1; k >= 0; --k) {
+            const int u = inst.topo[k];
+            uint64_t* ru = &reach[(size_t)u * words];
+            for (int v : inst.succs[u]) {
+                const uint64_t* rv = &reach[(size_t)v * words];
+                for (size_t w = 0; w < words; ++w) ru[w] |= rv[w];
+                ru[v / 64] |= uint64_t(1) << (v % 64);
+            }
+            long long cnt = 0;
+            for (size_t w = 0; w < words; ++w) cnt += (long long)std::bitset<64>(ru[w]).count();
+            score[u] = (double)cnt;
+        }
+    }
+    for (int j = 0; j < N; ++j) {
+        switch (rule) {
+        case PriorityRule::LFT: score[j] = -(double)(T - inst.tail[j]); break;
+        case PriorityRule::LST: score[j] = -(double)(T - inst.tail[j] - inst.dur[j]); break;
+        case PriorityRule::GRPW:
+            score[j] = inst.dur[j];
+            for (int v : inst.succs[j]) score[j] += inst.dur[v];
+            break;
+        default: break;
+        }
+    }
+
+    Veci indeg(N);
+    for (int j = 0; j < N; ++j) indeg[j] = (int)inst.preds[j].size();
+    Veci eligible;
+    for (int j = 0; j < N; ++j) if (indeg[j] == 0) eligible.push_back(j);
+
+    Veci order;
+    order.reserve(N);
+    Vecr val, weight;
+    while (!eligible.empty()) {
+
+        const int E = (int)eligible.size();
+        val.resize(E);
+        if (rule == PriorityRule::RSM) {
+            // задержка j, если i встанет перед ней: max(0, EF_i - LS_j); берётся худшая по остальным готовым,
+            // для чего нужны два наименьших LS
+            int ls1 = std::numeric_limits<int>::max(), ls2 = ls1, arg1 = -1;
+            for (int k = 0; k < E; ++k) {
+                const int j = eligible[k];
+                const int ls = T - inst.tail[j] - inst.dur[j];
+                if (ls < ls1) { ls2 = ls1; ls1 = ls; arg1 = k; }
+                else if (ls < ls2) ls2 = ls;
+            }
+            for (int k = 0; k < E; ++k) {
+                const int j = eligible[k];
+                const int lsOther = k == arg1 ? ls2 : ls1;
+                const int ef = inst.head[j] + inst.dur[j];
+                val[k] = lsOther == std::numeric_limits<int>::max() ? 0.0 : -(double)std::max(0, ef - lsOther);
+            }
+        } else {
+            for (int k = 0; k < E; ++k) val[k] = score[eligible[k]];
+        }
+
+        int pick = 0;
+        if (!rng) {
+            for (int k = 1; k < E; ++k)
+                if (val[k] > val[pick] || (val[k] == val[pick] && eligible[k] < eligible[pick])) pick = k;
+        } else {
+            // сожаление - отрыв от худшей готовой работы
+            const double worst = *std::min_element(val.begin(), val.end());
+            weight.resize(E);
+            for (int k = 0; k < E; ++k) weight[k] = std::pow(val[k] - worst + 1.0, alpha);
+            std::discrete_distribution<int> dist(weight.begin(), weight.end());
+            pick = dist(*rng);
+        }
+
+        const int u = eligible[pick];
+        eligible[pick] = eligible.back();
+        eligible.pop_back();
+        order.push_back(u);
+        for (int v : inst.succs[u])
+            if (--indeg[v] == 0) eligible.push_back(v);
+
+    }
+    return order;
+}
+//
+
+
 // реализация генерации популяции
 Individs init_population(
                          Instance const& inst, // начальные данные
                          int POP,              // количество особей в популяции
                          std::mt19937& rng,    // генератор случайных чисел
                          double topo_share,     // доля перестановок работ, удовлетворяющих порядку выполнения(вещественное число в интервале(0, 1))
-                         DecoderWS& ws
+                         DecoderWS& ws,
+                         double rule_share,    // доля перестановок из правил приоритета
+                         double alpha          // смещение выборки по сожалению
                         )
 {
 
     Individs pop;     // популяция
     pop.reserve(POP); // выделение памяти под заданное количество особей
 
-    int topo_cnt = (int)(POP * topo_share); // количество особей, удовлетворяющих порядку выполнения
+    // особи из правил приоритета: сначала детерминированные списки, затем выборка по сожалению
+    const int rule_cnt = std::min(POP, (int)(POP * rule_share));
+    for (int i = 0; i < rule_cnt; ++i) {
+        Individ ind;
+        ind.perm = priority_rule_perm(inst, priority_rules[i % priority_rule_count],
+                                      i < priority_rule_count ? nullptr : &rng, alpha);
+        evaluate_individ(inst, ind, ws);
+        pop.push_back(std::move(ind));
+    }
+
+    int topo_cnt = rule_cnt + (int)((POP - rule_cnt) * topo_share); // количество особей, удовлетворяющих порядку выполнения
 
     // генерация топологически верных перестановок работ
-    for (int i = 0; i < topo_cnt; ++i) {
+    for (int i = rule_cnt; i < topo_cnt; ++i) {
         Individ ind;      
         ind.perm = make_random_topo_perm(inst, rng);
-        ind.cmax = evaluate_cmax(inst, ind.perm, ws); 
+        evaluate_individ(inst, ind, ws);
         pop.push_back(std::move(ind));
     }
     //
@@ -163,7 +517,7 @@ Individs init_population(
     for (int i = topo_cnt; i < POP; ++i) {
         Individ ind;
         ind.perm = make_random_perm(inst.N, rng);
-        ind.cmax = evaluate_cmax(inst, ind.perm, ws);
+        evaluate_individ(inst, ind, ws);
         pop.push_back(std::move(ind));
     }
     //
@@ -177,6 +531,9 @@ Individs init_population(
 int compute_H(const Instance& inst) {
     int sumDur = std::accumulate(inst.dur.begin(), inst.dur.end(), 0);
     int maxRel = *std::max_element(inst.rel.begin(), inst.rel.end());
+    // после последнего излома календарей мощности постоянны, до него план может простаивать
+    for (auto const& cal : inst.calendars)
+        if (!cal.empty()) maxRel = std::max(maxRel, cal.back().first);
     return maxRel + sumDur + 5;
 }
 //
@@ -184,24 +541,41 @@ int compute_H(const Instance& inst) {
 
 // инициализация данных для декодера
 void init_ws(const Instance& inst, DecoderWS& ws) {
+    // состояние оценки - по умолчанию (рабочая область может переиспользоваться)
+    ws.cutoff = std::numeric_limits<int>::max();
+    ws.scenarios = nullptr;
+    ws.objective = Objective::Makespan;
+    ws.level.on = false;
+
     ws.H = compute_H(inst);
-    ws.usage.assign(inst.M, Veci(ws.H, 0));
+    ws.usage.assign(ws.H, inst.M, 0); // такт - строка
     ws.S.start.assign(inst.N, -1);
     ws.S.finish.assign(inst.N, -1);
     ws.remPred.assign(inst.N, 0);
     ws.done.assign(inst.N, 0);
+    ws.pos.assign(inst.N, 0);
+    ws.eligible.reserve(inst.N);
+    ws.events.reserve(inst.N);
+
+    // плотные потребности для ядер с фиксированным числом ресурсов
+    ws.demand = Gridi();
+    if (inst.M <= max_fixed_resources && inst.calendars.empty()) {
+        ws.demand.assign(inst.N, inst.M, 0);
+        for (int j = 0; j < inst.N; ++j)
+            for (auto [m, qty] : inst.demands[j]) ws.demand(j, m) += qty;
+    }
 }
 //
 
 
 // перезаполнение данных для декодера
 void reset_ws(const Instance& inst, DecoderWS& ws) {
-    for (int m = 0; m < inst.M; ++m)
-        std::fill(ws.usage[m].begin(), ws.usage[m].end(), 0);
+    ws.usage.fill(0);
 
     std::fill(ws.S.start.begin(), ws.S.start.end(), -1);
     std::fill(ws.S.finish.begin(), ws.S.finish.end(), -1);
     ws.S.cmax = 0;
+    ws.level.sumSq = ws.level.peak = ws.level.overload = 0;
 
     for (int j = 0; j < inst.N; ++j)
         ws.remPred[j] = (int)inst.preds[j].size();
@@ -211,6 +585,9 @@ void reset_ws(const Instance& inst, DecoderWS& ws) {
 //
 
 
+static int scenario_quantile_cmax(const Veci& perm, DecoderWS& ws);
+
+
 // вычисление времени конца данной рабочей перестановки
 int evaluate_cmax(
                   const Instance& inst, // начальные данные
@@ -218,47 +595,301 @@ int evaluate_cmax(
                   DecoderWS& ws
                  )
 {
-    return serial_decode_SGS(inst, perm, ws).cmax; // декодер(считаем время, за которое может выполниться данная перестановка)
+    if (ws.scenarios) return scenario_quantile_cmax(perm, ws);
+    if (ws.kind == DecoderKind::Best) // обе схемы без копирования расписаний
+        return std::min(serial_decode_SGS(inst, perm, ws).cmax, parallel_decode_SGS(inst, perm, ws).cmax);
+    return decode(inst, perm, ws).cmax; // декодер(считаем время, за которое может выполниться данная перестановка)
 }
 //
 
 
-// usage[m][t] = сколько занято ресурса m в момент t
-bool can_place(const Instance& inst, // начальные данные
-               int job,              // номер работы
-               int t,                // текущее время постанвоки работы
-               const VecVeci& usage  //
-              )
+void set_objective(const Instance& inst, Objective objective, int deadline, double deadlinePenalty,
+                   Veci const& overloadLevel, DecoderWS& ws)
+{
+    const int M = inst.M;
+    if (!overloadLevel.empty() && (int)overloadLevel.size() != M)
+        throw std::invalid_argument("overload level must be given for every resource");
+
+    ws.objective = objective;
+    ws.deadline = deadline;
+    ws.deadlinePenalty = deadlinePenalty;
+    LevelStats& st = ws.level;
+    st.on = objective != Objective::Makespan;
+    st.invCap.assign(M, 0.0);
+    for (int m = 0; m < M; ++m) st.invCap[m] = inst.cap[m] > 0 ? 1.0 / inst.cap[m] : 0.0;
+
+    if (!overloadLevel.empty()) {
+        st.level = overloadLevel;
+        return;
+    }
+    // идеально ровный профиль: работа ресурса, распределённая поровну до срока
+    const int horizon = std::max(1, deadline > 0 ? deadline : lower_bound_cmax(inst));
+    std::vector<long long> work(M, 0);
+    for (int j = 0; j < inst.N; ++j)
+        for (auto [m, qty] : inst.demands[j]) work[m] += (long long)qty * inst.dur[j];
+    st.level.assign(M, 0);
+    for (int m = 0; m < M; ++m) st.level[m] = (int)((work[m] + horizon - 1) / horizon);
+}
+
+
+// цель по показателям последнего декодирования
+static double objective_value(int cmax, const DecoderWS& ws)
+{
+    double f = 0;
+    switch (ws.objective) {
+    case Objective::SquaredUsage: f = ws.level.sumSq; break;
+    case Objective::MaxPeak: f = ws.level.peak; break;
+    case Objective::Overload: f = ws.level.overload; break;
+    default: return cmax;
+    }
+    if (ws.deadline > 0 && cmax > ws.deadline) f += ws.deadlinePenalty * (cmax - ws.deadline);
+    return f;
+}
+
+
+void evaluate_individ(const Instance& inst, Individ& ind, DecoderWS& ws)
+{
+    if (ws.objective == Objective::Makespan) {
+        ind.cmax = evaluate_cmax(inst, ind.perm, ws);
+        ind.fitness = ind.cmax;
+        return;
+    }
+
+    // показатели живут в рабочей области до следующего декодирования; для Best - лучшая из двух схем
+    ind.cmax = ws.kind == DecoderKind::Parallel ? parallel_decode_SGS(inst, ind.perm, ws).cmax
+                                                : serial_decode_SGS(inst, ind.perm, ws).cmax;
+    ind.fitness = objective_value(ind.cmax, ws);
+    if (ws.kind == DecoderKind::Best) {
+        const int c = parallel_decode_SGS(inst, ind.perm, ws).cmax;
+        const double f = objective_value(c, ws);
+        if (f < ind.fitness || (f == ind.fitness && c < ind.cmax)) {
+            ind.cmax = c;
+            ind.fitness = f;
+        }
+    }
+}
+//
+
+
+// мощность по календарю: поиск отрезка двоичный
+int capacity_at(const Instance& inst, int m, int t, int& end)
+{
+    end = std::numeric_limits<int>::max();
+    if (inst.calendars.empty() || inst.calendars[m].empty()) return inst.cap[m];
+
+    const VecPairii& cal = inst.calendars[m];
+    auto it = std::upper_bound(cal.begin(), cal.end(), t,
+                               [](int v, const Pairii& br) { return v < br.first; });
+    if (it != cal.end()) end = it->first;
+    return it == cal.begin() ? inst.cap[m] : std::prev(it)->second;
+}
+
+
+// ближайший старт работы не раньше t: t, если помещается; иначе момент сразу за найденным конфликтом
+// (все старты до него накрывают конфликтный такт) или конец отрезка календаря, где мощности не хватает вовсе
+int next_fit_start(const Instance& inst, // начальные данные
+                   int job,              // номер работы
+                   int t,                // текущее время постанвоки работы
+                   const Gridi& usage    // usage(t, m) = сколько занято ресурса m в момент t
+                  )
 {
 
     int d = inst.dur[job]; // длительность работы
-    // сделаем проходку по всем потребяностям данной работы
-    for (auto [m, qty] : inst.demands[job]) { 
+
+    // с календарями: по каждой потребности обходим отрезки постоянной мощности
+    if (!inst.calendars.empty()) {
+        for (auto [m, qty] : inst.demands[job]) {
+            int tt = t;
+            while (tt < t + d) {
+                int end;
+                const int c = capacity_at(inst, m, tt, end);
+                if (qty > c) {
+                    // последний отрезок бесконечен: работа не поместится никогда
+                    if (end == std::numeric_limits<int>::max())
+                        throw std::invalid_argument("job " + std::to_string(job) + " never fits the calendar of resource "
+                                                    + std::to_string(m));
+                    return end; // выходные, ремонт: отрезок пропускается целиком
+                }
+                const int stop = std::min(end, t + d);
+                for (; tt < stop; ++tt) {
+                    if (usage(tt, m) + qty > c) return tt + 1;
+                }
+            }
+        }
+        return t;
+    }
+
+    // сделаем проходку по тактам работы, в такте - по всем потребностям (одна строка сетки)
+    for (int tt = t; tt < t + d; ++tt) {
+        Span<const int> row = usage.row(tt);
         // хватит ли ресурсов для этой работы ?
-        for (int tt = t; tt < t + d; ++tt) {
-            if (usage[m][tt] + qty > inst.cap[m]) return false;
+        for (auto [m, qty] : inst.demands[job]) {
+            if (row[m] + qty > inst.cap[m]) return tt + 1;
         }
         //
     }
     //
-    return true;
+    return t;
+
+}
+
+
+// usage(t, m) = сколько занято ресурса m в момент t
+bool can_place(const Instance& inst, // начальные данные
+               int job,              // номер работы
+               int t,                // текущее время постанвоки работы
+               const Gridi& usage    //
+              )
+{
+    return next_fit_start(inst, job, t, usage) == t;
+}
+
+void place_job(const Instance& inst, int job, int t,
+                      Gridi& usage)
+{
+    int d = inst.dur[job];
+    for (int tt = t; tt < t + d; ++tt) {
+        Span<int> row = usage.row(tt);
+        for (auto [m, qty] : inst.demands[job]) {
+            row[m] += qty;
+        }
+    }
+}
+
 
+// приращения показателей выравнивания в клетке с потреблением u, к которому добавляется q;
+// invCap - 1 / мощность ресурса m в этом такте
+static inline void level_cell(LevelStats& st, int m, int u, int q, double invCap)
+{
+    const int v = u + q;
+    st.sumSq += (double)q * (2.0 * u + q);
+    st.peak = std::max(st.peak, v * invCap);
+    st.overload += std::max(0, v - st.level[m]) - std::max(0, u - st.level[m]);
 }
 
+
 void place_job(const Instance& inst, int job, int t,
-                      VecVeci& usage)
+                      Gridi& usage, LevelStats& st)
 {
     int d = inst.dur[job];
-    for (auto [m, qty] : inst.demands[job]) {
-        for (int tt = t; tt < t + d; ++tt) {
-            usage[m][tt] += qty;
+
+    // с календарями доля пика считается от мощности отрезка, в который попал такт
+    if (!inst.calendars.empty()) {
+        for (auto [m, qty] : inst.demands[job]) {
+            int tt = t;
+            while (tt < t + d) {
+                int end;
+                const int c = capacity_at(inst, m, tt, end);
+                const double inv = c > 0 ? 1.0 / c : 0.0;
+                const int stop = std::min(end, t + d);
+                for (; tt < stop; ++tt) {
+                    int& u = usage(tt, m);
+                    level_cell(st, m, u, qty, inv);
+                    u += qty;
+                }
+            }
+        }
+        return;
+    }
+
+    for (int tt = t; tt < t + d; ++tt) {
+        Span<int> row = usage.row(tt);
+        for (auto [m, qty] : inst.demands[job]) {
+            level_cell(st, m, row[m], qty, st.invCap[m]);
+            row[m] += qty;
         }
     }
 }
 
 
 // реализация декодера вовзвращает структуру - график работ
-Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws)
+// ядра проверки и размещения работы: общее - по парам потребностей (календари, любое M),
+// фиксированное - по плотной строке потребностей из MM ресурсов, циклы по ресурсам раскрываются компилятором
+struct GenericKernel {
+
+    const Instance& inst;
+
+    int fit(int job, int t, const Gridi& usage) const { return next_fit_start(inst, job, t, usage); }
+    void place(int job, int t, Gridi& usage) const { place_job(inst, job, t, usage); }
+    void place(int job, int t, Gridi& usage, LevelStats& st) const { place_job(inst, job, t, usage, st); }
+
+};
+
+
+template <int MM>
+struct FixedKernel {
+
+    const Instance& inst;
+    const Gridi& demand;  // N x M, плотные потребности
+    int cap[MM];
+
+    FixedKernel(const Instance& inst, const Gridi& demand) : inst(inst), demand(demand) {
+        for (int m = 0; m < MM; ++m) cap[m] = inst.cap[m];
+    }
+
+    // то же, что next_fit_start без календарей: первый конфликтный такт по времени
+    int fit(int job, int t, const Gridi& usage) const {
+        int d[MM];
+        for (int m = 0; m < MM; ++m) d[m] = demand(job, m);
+        const int end = t + inst.dur[job];
+        const size_t ld = usage.stride();
+        const int* row = usage.data() + (size_t)t * ld;
+        for (int tt = t; tt < end; ++tt, row += ld) {
+            bool over = false;
+            for (int m = 0; m < MM; ++m) over |= row[m] + d[m] > cap[m];
+            if (over) return tt + 1;
+        }
+        return t;
+    }
+
+    void place(int job, int t, Gridi& usage) const {
+        int d[MM];
+        for (int m = 0; m < MM; ++m) d[m] = demand(job, m);
+        const int end = t + inst.dur[job];
+        const size_t ld = usage.stride();
+        int* row = usage.data() + (size_t)t * ld;
+        for (int tt = t; tt < end; ++tt, row += ld) {
+            for (int m = 0; m < MM; ++m) row[m] += d[m];
+        }
+    }
+
+    void place(int job, int t, Gridi& usage, LevelStats& st) const {
+        int d[MM];
+        for (int m = 0; m < MM; ++m) d[m] = demand(job, m);
+        const int end = t + inst.dur[job];
+        const size_t ld = usage.stride();
+        int* row = usage.data() + (size_t)t * ld;
+        for (int tt = t; tt < end; ++tt, row += ld) {
+            for (int m = 0; m < MM; ++m) {
+                if (d[m] == 0) continue;
+                level_cell(st, m, row[m], d[m], st.invCap[m]);
+                row[m] += d[m];
+            }
+        }
+    }
+
+};
+
+
+// выбор ядра по числу ресурсов: плотные потребности готовит init_ws для M <= max_fixed_resources без календарей
+template <class Body>
+static Schedule with_kernel(const Instance& inst, const DecoderWS& ws, Body const& body)
+{
+    if ((int)ws.demand.rows() == inst.N && inst.N > 0) {
+        switch (inst.M) {
+        case 1: return body(FixedKernel<1>(inst, ws.demand));
+        case 2: return body(FixedKernel<2>(inst, ws.demand));
+        case 3: return body(FixedKernel<3>(inst, ws.demand));
+        case 4: return body(FixedKernel<4>(inst, ws.demand));
+        default: break;
+        }
+    }
+    return body(GenericKernel{inst});
+}
+
+
+template <class Kernel>
+static Schedule serial_decode_impl(const Instance& inst, const Veci& perm, DecoderWS& ws, const Kernel& K)
 {
     const int N = inst.N; // количество работ
     const int M = inst.M; // количество ресурсов
@@ -278,15 +909,16 @@ Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws
         //
 
         // возможное время начала работы
-        int ES = inst.rel[job]; // минимальное время старта
+        int ES = inst.head.empty() ? inst.rel[job] : inst.head[job]; // минимальное время старта (голова не меньше rel)
         for (int p : inst.preds[job]) ES = std::max(ES, ws.S.finish[p]); // и сравнение с концом выполненности предшественников
         //
 
         // учитывание доступности ресурсов
         int t = ES;
         while (true) {
-            if (can_place(inst, job, t, ws.usage)) break;
-            ++t; // сдвиг вправо
+            const int nt = K.fit(job, t, ws.usage);
+            if (nt == t) break;
+            t = nt; // сдвиг вправо за конфликт
         }
         //
 
@@ -294,7 +926,12 @@ Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws
         // фиксируем в графике расписание данной работы
         ws.S.start[job]  = t;
         ws.S.finish[job] = t + inst.dur[job];
-        place_job(inst, job, t, ws.usage);
+        if (ws.level.on) K.place(job, t, ws.usage, ws.level);
+        else K.place(job, t, ws.usage);
+        if (ws.S.finish[job] >= ws.cutoff) { // хуже отсечения: дальше можно не строить
+            ws.S.cmax = ws.S.finish[job];
+            return ws.S;
+        }
         //
 
         ws.done[job] = 1; // работа выполнена
@@ -311,9 +948,138 @@ Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws
 }
 
 
+Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws)
+{
+    return with_kernel(inst, ws, [&](auto const& K) { return serial_decode_impl(inst, perm, ws, K); });
+}
+
+
+
+// реализация параллельной схемы: в момент t просматриваются готовые работы в порядке перестановки
+// и ставятся все, что помещаются по ресурсам; затем t переходит к ближайшему окончанию или готовности
+template <class Kernel>
+static Schedule parallel_decode_impl(const Instance& inst, const Veci& perm, DecoderWS& ws, const Kernel& K)
+{
+    const int N = inst.N;
+
+    reset_ws(inst, ws);
+    for (int k = 0; k < N; ++k) ws.pos[perm[k]] = k;
+    auto byPos = [&](int a, int b) { return ws.pos[a] < ws.pos[b]; };
+
+    ws.eligible.clear();
+    for (int j = 0; j < N; ++j) if (ws.remPred[j] == 0) ws.eligible.push_back(j);
+    std::sort(ws.eligible.begin(), ws.eligible.end(), byPos);
+    ws.events.clear();
+
+    int doneCnt = 0;
+    int t = 0;
+    Veci released; // работы, ставшие готовыми в этот момент
+    while (doneCnt < N) {
+
+        int next = std::numeric_limits<int>::max(); // следующий момент решения
+        size_t keep = 0;
+        for (size_t k = 0; k < ws.eligible.size(); ++k) {
+
+            const int job = ws.eligible[k];
+            int ES = inst.head.empty() ? inst.rel[job] : inst.head[job];
+            for (int p : inst.preds[job]) ES = std::max(ES, ws.S.finish[p]);
+
+            if (ES <= t && K.fit(job, t, ws.usage) == t) {
+                ws.S.start[job] = t;
+                ws.S.finish[job] = t + inst.dur[job];
+                if (ws.level.on) K.place(job, t, ws.usage, ws.level);
+                else K.place(job, t, ws.usage);
+                if (ws.S.finish[job] >= ws.cutoff) {
+                    ws.S.cmax = ws.S.finish[job];
+                    return ws.S;
+                }
+                ws.done[job] = 1;
+                ++doneCnt;
+                ws.events.push_back(ws.S.finish[job]);
+                std::push_heap(ws.events.begin(), ws.events.end(), std::greater<int>());
+                for (int s : inst.succs[job]) if (--ws.remPred[s] == 0) released.push_back(s);
+                continue;
+            }
+            if (ES > t) next = std::min(next, ES);
+            ws.eligible[keep++] = job;
+
+        }
+        ws.eligible.resize(keep);
+
+        // новые готовые работы вливаются с сохранением порядка перестановки
+        if (!released.empty()) {
+            std::sort(released.begin(), released.end(), byPos);
+            const size_t mid = ws.eligible.size();
+            ws.eligible.insert(ws.eligible.end(), released.begin(), released.end());
+            std::inplace_merge(ws.eligible.begin(), ws.eligible.begin() + mid, ws.eligible.end(), byPos);
+            for (int j : released) {
+                int ES = inst.head.empty() ? inst.rel[j] : inst.head[j];
+                for (int p : inst.preds[j]) ES = std::max(ES, ws.S.finish[p]);
+                next = std::min(next, ES);
+            }
+            released.clear();
+        }
+
+        // ближайшее окончание после t освобождает ресурсы
+        while (!ws.events.empty() && ws.events.front() <= t) {
+            std::pop_heap(ws.events.begin(), ws.events.end(), std::greater<int>());
+            ws.events.pop_back();
+        }
+        if (!ws.events.empty()) next = std::min(next, ws.events.front());
+
+        // ждущая работа может поместиться и после смены мощности по календарю
+        if (!ws.eligible.empty()) {
+            for (int m = 0; m < (int)inst.calendars.size(); ++m) {
+                int end;
+                capacity_at(inst, m, t, end);
+                next = std::min(next, end);
+            }
+        }
+
+        if (next == std::numeric_limits<int>::max()) break; // работа не помещается даже в пустые ресурсы
+        t = next;
+
+    }
+
+    for (int j = 0; j < N; ++j) ws.S.cmax = std::max(ws.S.cmax, ws.S.finish[j]);
+    return ws.S;
+
+}
+
+
+Schedule parallel_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws)
+{
+    return with_kernel(inst, ws, [&](auto const& K) { return parallel_decode_impl(inst, perm, ws, K); });
+}
+
 
-// сортировка: меньше cmax — лучше
+// реализация выбора декодера
+Schedule decode(const Instance& inst, const Veci& perm, DecoderWS& ws)
+{
+    switch (ws.kind) {
+    case DecoderKind::Parallel:
+        return parallel_decode_SGS(inst, perm, ws);
+    case DecoderKind::Best: {
+        // с целью выравнивания - та же схема, что выбрал evaluate_individ
+        Schedule s = serial_decode_SGS(inst, perm, ws);
+        const double fs = objective_value(s.cmax, ws);
+        Schedule p = parallel_decode_SGS(inst, perm, ws);
+        if (ws.level.on) {
+            const double fp = objective_value(p.cmax, ws);
+            return fp < fs || (fp == fs && p.cmax < s.cmax) ? p : s;
+        }
+        return p.cmax < s.cmax ? p : s;
+    }
+    default:
+        return serial_decode_SGS(inst, perm, ws);
+    }
+}
+
+
+
+// сортировка: меньше fitness (при равенстве - cmax) — лучше
 bool better(const Individ& a, const Individ& b) {
+    if (a.fitness != b.fitness) return a.fitness < b.fitness;
     return a.cmax < b.cmax;
 }
 
@@ -329,7 +1095,7 @@ int tournament_select(
     int bestIdx = dist(rng);
     for (int i = 1; i < k; ++i) {
         int cand = dist(rng);
-        if (pop[cand].cmax < pop[bestIdx].cmax) bestIdx = cand;
+        if (better(pop[cand], pop[bestIdx])) bestIdx = cand;
     }
     return bestIdx;
 
@@ -433,11 +1199,713 @@ Individs next_generation(
 
         Individ ind;
         ind.perm = std::move(child);
-        ind.cmax = evaluate_cmax(inst, ind.perm, ws);
+        evaluate_individ(inst, ind, ws);
         next.push_back(std::move(ind)); 
 
     }
 
     return next;
 }
+//
+
+
+// реализация контрольных точек
+// формат: "PCGA", версия, отпечаток задачи, N, поколение, счётчик застоя, лучшая особь (cmax, perm),
+// размер популяции и особи (cmax, perm), длина и текст состояния генератора; числа - int32 / uint64 как в памяти
+
+static const char checkpoint_magic[4] = {'P', 'C', 'G', 'A'};
+static const int32_t checkpoint_version = 1;
+
+
+uint64_t instance_fingerprint(const Instance& inst)
+{
+    uint64_t h = 1469598103934665603ull; // FNV-1a
+    auto mix = [&](long long v) {
+        for (int b = 0; b < 8; ++b) {
+            h ^= (uint64_t)(v >> (8 * b)) & 0xFF;
+            h *= 1099511628211ull;
+        }
+    };
+    mix(inst.N);
+    mix(inst.M);
+    for (int j = 0; j < inst.N; ++j) {
+        mix(inst.dur[j]);
+        mix(inst.rel[j]);
+        for (auto [m, qty] : inst.demands[j]) { mix(m); mix(qty); }
+        for (int p : inst.preds[j]) mix(p);
+        mix(-1);
+    }
+    for (int c : inst.cap) mix(c);
+    for (auto const& cal : inst.calendars)
+        for (auto [t, c] : cal) { mix(t); mix(c); }
+    return h;
+}
+
+
+static void write_i32(std::ostream& os, int32_t v) { os.write(reinterpret_cast<const char*>(&v), sizeof(v)); }
+
+
+static int32_t read_i32(std::istream& is)
+{
+    int32_t v = 0;
+    if (!is.read(reinterpret_cast<char*>(&v), sizeof(v))) throw std::runtime_error("truncated checkpoint");
+    return v;
+}
+
+
+static void write_individ(std::ostream& os, const Individ& ind)
+{
+    write_i32(os, ind.cmax);
+    os.write(reinterpret_cast<const char*>(ind.perm.data()), (std::streamsize)(ind.perm.size() * sizeof(int32_t)));
+}
+
+
+static Individ read_individ(std::istream& is, int N)
+{
+    Individ ind;
+    ind.cmax = read_i32(is);
+    ind.perm.resize(N);
+    if (!is.read(reinterpret_cast<char*>(ind.perm.data()), (std::streamsize)(N * sizeof(int32_t))))
+        throw std::runtime_error("truncated checkpoint");
+    Veci seen(N, 0);
+    for (int j : ind.perm) {
+        if (j < 0 || j >= N || seen[j]++) throw std::runtime_error("corrupt permutation in checkpoint");
+    }
+    return ind;
+}
+
+
+// запись tmp на диск и замена им path одной операцией: старая точка остаётся, пока новая не на месте
+static void replace_file(const std::string& tmp, const std::string& path)
+{
+#ifdef _WIN32
+    const int fd = _open(tmp.c_str(), _O_RDWR | _O_BINARY);
+    const bool synced = fd >= 0 && _commit(fd) == 0;
+    if (fd >= 0) _close(fd);
+    if (!synced) throw std::runtime_error("cannot flush checkpoint " + tmp);
+    if (!MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+        throw std::runtime_error("cannot replace checkpoint " + path);
+#else
+    const int fd = ::open(tmp.c_str(), O_RDONLY);
+    const bool synced = fd >= 0 && ::fsync(fd) == 0;
+    if (fd >= 0) ::close(fd);
+    if (!synced) throw std::runtime_error("cannot flush checkpoint " + tmp);
+    if (std::rename(tmp.c_str(), path.c_str()) != 0) throw std::runtime_error("cannot replace checkpoint " + path);
+#endif
+}
+
+
+void save_checkpoint(const std::string& path, const Instance& inst, const GAState& st)
+{
+    static_assert(sizeof(int) == sizeof(int32_t), "perm is stored as int32");
+    const std::string tmp = path + ".tmp";
+    {
+        std::ofstream os(tmp, std::ios::binary | std::ios::trunc);
+        if (!os) throw std::runtime_error("cannot write checkpoint " + tmp);
+
+        os.write(checkpoint_magic, 4);
+        write_i32(os, checkpoint_version);
+        const uint64_t fp = instance_fingerprint(inst);
+        os.write(reinterpret_cast<const char*>(&fp), sizeof(fp));
+        write_i32(os, inst.N);
+        write_i32(os, st.generation);
+        write_i32(os, st.stall);
+        write_individ(os, st.best);
+        write_i32(os, (int32_t)st.pop.size());
+        for (auto const& ind : st.pop) write_individ(os, ind);
+        write_i32(os, (int32_t)st.rng.size());
+        os.write(st.rng.data(), (std::streamsize)st.rng.size());
+
+        os.flush();
+        if (!os) throw std::runtime_error("cannot write checkpoint " + tmp);
+    }
+    // прежняя точка заменяется только целиком записанной
+    replace_file(tmp, path);
+}
+
+
+GAState load_checkpoint(const std::string& path, const Instance& inst)
+{
+    std::ifstream is(path, std::ios::binary);
+    if (!is) throw std::runtime_error("cannot open checkpoint " + path);
+
+    char magic[4];
+    if (!is.read(magic, 4) || std::memcmp(magic, checkpoint_magic, 4) != 0) throw std::runtime_error("not a GA checkpoint: " + path);
+    if (read_i32(is) != checkpoint_version) throw std::runtime_error("unsupported checkpoint version");
+    uint64_t fp = 0;
+    if (!is.read(reinterpret_cast<char*>(&fp), sizeof(fp))) throw std::runtime_error("truncated checkpoint");
+    if (fp != instance_fingerprint(inst) || read_i32(is) != inst.N)
+        throw std::runtime_error("checkpoint was written for another instance");
+
+    GAState st;
+    st.generation = read_i32(is);
+    st.stall = read_i32(is);
+    st.best = read_individ(is, inst.N);
+    const int POP = read_i32(is);
+    if (POP <= 0) throw std::runtime_error("corrupt checkpoint");
+    st.pop.reserve(POP);
+    for (int i = 0; i < POP; ++i) st.pop.push_back(read_individ(is, inst.N));
+    const int len = read_i32(is);
+    if (len < 0) throw std::runtime_error("corrupt checkpoint");
+    st.rng.resize(len);
+    if (len > 0 && !is.read(&st.rng[0], len)) throw std::runtime_error("truncated checkpoint");
+    return st;
+}
+//
+
+
+// реализация BRKGA
+
+void keys_to_perm(const Vecf& keys, Veci& perm, KeySortWS& ks)
+{
+    const int N = (int)keys.size();
+    perm.clear();
+    if (N == 0) return;
+    ks.bits.resize(N);
+    ks.bitsTmp.resize(N);
+    ks.idxTmp.resize(N);
+    perm.resize(N);
+
+    // монотонное отображение float -> uint32: у отрицательных инвертируются все биты, у остальных - знаковый
+    for (int j = 0; j < N; ++j) {
+        uint32_t b;
+        std::memcpy(&b, &keys[j], sizeof(b));
+        ks.bits[j] = (b & 0x80000000u) ? ~b : (b | 0x80000000u);
+        perm[j] = j;
+    }
+
+    for (int shift = 0; shift < 32; shift += 8) {
+
+        int cnt[257] = {0};
+        for (int j = 0; j < N; ++j) ++cnt[((ks.bits[j] >> shift) & 0xFF) + 1];
+        if (cnt[((ks.bits[0] >> shift) & 0xFF) + 1] == N) continue; // байт у всех одинаков - проход не нужен
+        for (int d = 0; d < 256; ++d) cnt[d + 1] += cnt[d];
+
+        for (int j = 0; j < N; ++j) {
+            const int dst = cnt[(ks.bits[j] >> shift) & 0xFF]++;
+            ks.bitsTmp[dst] = ks.bits[j];
+            ks.idxTmp[dst] = perm[j];
+        }
+        ks.bits.swap(ks.bitsTmp);
+        perm.swap(ks.idxTmp);
+
+    }
+}
+
+
+void crossover_biased(const Vecf& elite, const Vecf& other, double rhoE, Vecf& child, std::mt19937& rng)
+{
+    const int N = (int)elite.size();
+    child.resize(N);
+    std::uniform_real_distribution<float> ur(0.0f, 1.0f);
+    const float rho = (float)rhoE;
+    for (int j = 0; j < N; ++j) {
+        const float u = ur(rng);
+        child[j] = u < rho ? elite[j] : other[j]; // выбор без ветвления
+    }
+}
+
+
+// новая случайная особь
+static void random_keys(Vecf& keys, int N, std::mt19937& rng)
+{
+    std::uniform_real_distribution<float> ur(0.0f, 1.0f);
+    keys.resize(N);
+    for (auto& k : keys) k = ur(rng);
+}
+
+
+Individ run_BRKGA(const Instance& inst, const BRKGAParams& prm, std::mt19937& rng, DecoderWS& ws)
+{
+    const int N = inst.N;
+    const int POP = std::max(2, prm.POP);
+    const int ELITE = std::clamp((int)(POP * prm.eliteShare), 1, POP - 1);             // элита
+    const int MUT = std::clamp((int)(POP * prm.mutantShare), 0, POP - ELITE - 1);      // мутанты
+
+    KeySortWS ks;
+    Veci perm;
+    auto evaluate = [&](KeyIndivid& ind) {
+        keys_to_perm(ind.keys, perm, ks);
+        ind.cmax = evaluate_cmax(inst, perm, ws);
+    };
+    auto byCmax = [](const KeyIndivid& a, const KeyIndivid& b) { return a.cmax < b.cmax; };
+
+    KeyIndivids pop(POP), next(POP);
+    const int rule_cnt = std::min(POP, (int)(POP * prm.ruleShare));
+    for (int i = 0; i < POP; ++i) {
+        if (i < rule_cnt) {
+            // ключ работы - её позиция в списке правила
+            const Veci order = priority_rule_perm(inst, priority_rules[i % priority_rule_count],
+                                                  i < priority_rule_count ? nullptr : &rng, prm.regretAlpha);
+            pop[i].keys.resize(N);
+            for (int k = 0; k < N; ++k) pop[i].keys[order[k]] = (k + 0.5f) / N;
+        } else {
+            random_keys(pop[i].keys, N, rng);
+        }
+        evaluate(pop[i]);
+    }
+    std::sort(pop.begin(), pop.end(), byCmax);
+
+    Individ best;
+    keys_to_perm(pop[0].keys, best.perm, ks);
+    best.cmax = pop[0].cmax;
+
+    std::uniform_int_distribution<int> pickElite(0, ELITE - 1);
+    std::uniform_int_distribution<int> pickOther(ELITE, POP - 1);
+    int stall = 0;
+    const TimeLimit limit(prm.timeLimit);
+    for (int g = 1; g <= prm.GEN && stall < prm.stall && !limit.expired(); ++g) {
+
+        // элита копируется, мутанты случайны, остальные - дети элитного и неэлитного родителей
+        for (int i = 0; i < ELITE; ++i) next[i] = pop[i];
+        for (int i = ELITE; i < ELITE + MUT; ++i) {
+            random_keys(next[i].keys, N, rng);
+            evaluate(next[i]);
+        }
+        for (int i = ELITE + MUT; i < POP; ++i) {
+            crossover_biased(pop[pickElite(rng)].keys, pop[pickOther(rng)].keys, prm.rhoE, next[i].keys, rng);
+            evaluate(next[i]);
+        }
+        pop.swap(next);
+        std::sort(pop.begin(), pop.end(), byCmax);
+
+        if (pop[0].cmax < best.cmax) {
+            keys_to_perm(pop[0].keys, best.perm, ks);
+            best.cmax = pop[0].cmax;
+            stall = 0;
+        } else {
+            ++stall;
+        }
+
+    }
+    return best;
+}
+//
+
+
+// реализация оценки устойчивости
+
+// номер порядковой статистики для квантиля q (ближайший ранг)
+static int quantile_rank(double q, int S)
+{
+    return std::clamp((int)std::ceil(q * S) - 1, 0, S - 1);
+}
+
+
+// данные для декодирования сценариев: длительности наибольшие из выборки (для горизонта), головы
+// сброшены - при других длительностях они неверны, декодер берёт rel и окончания предшественников
+static Instance scenario_instance(const Instance& inst, const ScenarioSet& set)
+{
+    Instance sc = inst;
+    sc.head.clear();
+    sc.tail.clear();
+    for (int s = 0; s < set.S; ++s)
+        for (int j = 0; j < set.N; ++j) sc.dur[j] = std::max(sc.dur[j], set.dur[(size_t)s * set.N + j]);
+    return sc;
+}
+
+
+ScenarioSet sample_scenarios(const Instance& inst, const DurationModel& model, int S, unsigned seed)
+{
+    const int N = inst.N;
+    const bool exact = model.lo.empty() && model.hi.empty();
+    if (S <= 0) throw std::invalid_argument("number of scenarios must be positive");
+    if (!exact && ((int)model.lo.size() != N || (int)model.hi.size() != N))
+        throw std::invalid_argument("duration bounds must be given for every job");
+    for (int j = 0; j < N && !exact; ++j)
+        if (model.lo[j] < 0 || model.lo[j] > inst.dur[j] || model.hi[j] < inst.dur[j])
+            throw std::invalid_argument("duration bounds of job " + std::to_string(j) + " must satisfy 0 <= lo <= dur <= hi");
+
+    ScenarioSet set;
+    set.N = N;
+    set.S = S;
+    set.dur.resize((size_t)S * N);
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> ur(0.0, 1.0);
+    for (int s = 0; s < S; ++s)
+        for (int j = 0; j < N; ++j) {
+            int& d = set.dur[(size_t)s * N + j];
+            if (exact || model.lo[j] == model.hi[j]) { d = inst.dur[j]; continue; }
+            // обратная функция треугольного распределения
+            const double a = model.lo[j], c = inst.dur[j], b = model.hi[j], u = ur(rng);
+            const double x = u < (c - a) / (b - a) ? a + std::sqrt(u * (b - a) * (c - a))
+                                                   : b - std::sqrt((1 - u) * (b - a) * (b - c));
+            d = std::clamp((int)std::lround(x), model.lo[j], model.hi[j]);
+        }
+    return set;
+}
+
+
+void attach_scenarios(const Instance& inst, const ScenarioSet& set, double quantile, DecoderWS& ws)
+{
+    if (set.N != inst.N || set.S <= 0) throw std::invalid_argument("scenario set does not match the instance");
+    ws.scenario = scenario_instance(inst, set);
+    ws.scenarios = &set;
+    ws.scenarioQuantile = quantile;
+    ws.scenarioCmax.resize(set.S);
+    const int H = compute_H(ws.scenario);
+    if (H > ws.H) {
+        ws.H = H;
+        ws.usage.assign(ws.H, inst.M, 0);
+    }
+}
+
+
+static int scenario_quantile_cmax(const Veci& perm, DecoderWS& ws)
+{
+    const ScenarioSet* set = ws.scenarios;
+    const int N = set->N;
+    ws.scenarios = nullptr; // сами сценарии декодируются обычным образом
+    for (int s = 0; s < set->S; ++s) {
+        std::copy_n(set->dur.begin() + (size_t)s * N, N, ws.scenario.dur.begin());
+        ws.scenarioCmax[s] = evaluate_cmax(ws.scenario, perm, ws);
+    }
+    ws.scenarios = set;
+
+    auto q = ws.scenarioCmax.begin() + quantile_rank(ws.scenarioQuantile, set->S);
+    std::nth_element(ws.scenarioCmax.begin(), q, ws.scenarioCmax.end());
+    return *q;
+}
+
+
+RobustnessResult simulate_robustness(Instance inst, const Veci& perm, const DurationModel& model,
+                                     RobustnessOptions const& opt)
+{
+    const int N = inst.N;
+    preprocess_instance(inst);
+    if ((int)perm.size() != N) throw std::invalid_argument("permutation must hold every job once");
+    {
+        std::vector<char> seen(N, 0);
+        for (int job : perm) {
+            if (job < 0 || job >= N || seen[job]) throw std::invalid_argument("permutation must hold every job once");
+            seen[job] = 1;
+        }
+    }
+    const ScenarioSet set = sample_scenarios(inst, model, opt.scenarios, opt.seed);
+    const Instance base = scenario_instance(inst, set);
+    const int S = set.S;
+
+    RobustnessResult res;
+    res.cmax.assign(S, 0);
+    {
+        DecoderWS ws;
+        init_ws(inst, ws);
+        ws.kind = opt.decoder;
+        res.nominal = evaluate_cmax(inst, perm, ws);
+    }
+
+    // сценарии режутся на части, по несколько на поток; у каждой части свои данные и рабочая область
+    int threads = opt.threads > 0 ? opt.threads : (int)std::thread::hardware_concurrency();
+    const int parts = std::max(1, std::min(S, 4 * std::max(1, threads)));
+    const int rows = (S + parts - 1) / parts;
+    parallel_for(parts, [&](int part) {
+
+        const int s0 = part * rows;
+        const int s1 = std::min(S, s0 + rows);
+        if (s0 >= s1) return;
+        Instance sc = base;
+        DecoderWS ws;
+        init_ws(sc, ws);
+        ws.kind = opt.decoder;
+        for (int s = s0; s < s1; ++s) {
+            std::copy_n(set.dur.begin() + (size_t)s * N, N, sc.dur.begin());
+            res.cmax[s] = evaluate_cmax(sc, perm, ws);
+        }
+
+    }, threads);
+
+    // статистики по упорядоченной выборке
+    Veci sorted = res.cmax;
+    std::sort(sorted.begin(), sorted.end());
+    double sum = 0, sum2 = 0;
+    for (int c : sorted) { sum += c; sum2 += (double)c * c; }
+    res.mean = sum / S;
+    res.stddev = S > 1 ? std::sqrt(std::max(0.0, (sum2 - S * res.mean * res.mean) / (S - 1))) : 0.0;
+    res.levels = opt.levels;
+    for (double q : opt.levels) {
+        const double r = std::clamp(q, 0.0, 1.0) * (S - 1);
+        const int k = (int)r;
+        const double w = r - k;
+        res.quantiles.push_back(k + 1 < S ? (1 - w) * sorted[k] + w * sorted[k + 1] : sorted[k]);
+    }
+    return res;
+}
+//
+
+
+// пакетное декодирование
+DecodeBatchResult decode_batch(Instance inst, const Veci& perms, int K, bool withStarts, DecoderKind kind, int threads)
+{
+    const int N = inst.N;
+    if (K < 0 || perms.size() != (size_t)K * N)
+        throw std::invalid_argument("perms must hold K rows of N jobs");
+    preprocess_instance(inst);
+
+    // каждая строка - перестановка, иначе декодер не найдёт очередную работу
+    std::vector<int> seen(N, -1);
+    for (int k = 0; k < K; ++k)
+        for (int j = 0; j < N; ++j) {
+            const int job = perms[(size_t)k * N + j];
+            if (job < 0 || job >= N || seen[job] == k)
+                throw std::invalid_argument("row " + std::to_string(k) + " is not a permutation of jobs");
+            seen[job] = k;
+        }
+
+    DecodeBatchResult res;
+    res.K = K;
+    res.N = N;
+    res.cmax.assign(K, 0);
+    if (withStarts) res.start.assign((size_t)K * N, 0);
+    if (K == 0) return res;
+
+    // пакет режется на части, по несколько на поток; у каждой части своя рабочая область
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    const int parts = std::max(1, std::min(K, 4 * std::max(1, threads)));
+    const int rows = (K + parts - 1) / parts;
+    parallel_for(parts, [&](int part) {
+
+        const int k0 = part * rows;
+        const int k1 = std::min(K, k0 + rows);
+        if (k0 >= k1) return;
+        DecoderWS ws;
+        init_ws(inst, ws);
+        ws.kind = kind;
+        Veci perm(N);
+        for (int k = k0; k < k1; ++k) {
+            std::copy_n(perms.begin() + (size_t)k * N, N, perm.begin());
+            if (withStarts) {
+                const Schedule s = decode(inst, perm, ws); // для Best - лучшая из двух схем
+                res.cmax[k] = s.cmax;
+                std::copy(s.start.begin(), s.start.end(), res.start.begin() + (size_t)k * N);
+            } else {
+                res.cmax[k] = evaluate_cmax(inst, perm, ws);
+            }
+        }
+
+    }, threads);
+
+    return res;
+}
+//
+
+
+// реализация портфеля
+
+namespace {
+
+using PortfolioClock = std::chrono::steady_clock;
+
+
+// общее для методов: срок, флаг остановки, рекорд
+struct PortfolioShared {
+
+    PortfolioClock::time_point deadline;
+    std::atomic<bool> stop{false};
+    Incumbent incumbent;
+    int lowerBound = 0;
+
+    bool expired() {
+        if (stop.load(std::memory_order_relaxed)) return true;
+        if (PortfolioClock::now() >= deadline) stop.store(true, std::memory_order_relaxed);
+        return stop.load(std::memory_order_relaxed);
+    }
+
+    // сообщить о решении; нижняя оценка достигнута - остальные методы тоже останавливаются
+    void report(int cmax) {
+        incumbent.offer(cmax);
+        if (cmax <= lowerBound) stop.store(true, std::memory_order_relaxed);
+    }
+
+};
+
+
+// лучшее решение одного метода
+struct EngineBest {
+
+    Individ best;
+    long long evaluations = 0;
+
+    void consider(const Veci& perm, int cmax, PortfolioShared& sh) {
+        if (best.perm.empty() || cmax < best.cmax) {
+            best.perm = perm;
+            best.cmax = cmax;
+            best.fitness = cmax;
+            sh.report(cmax);
+        }
+    }
+
+};
+
+
+void portfolio_GA(const Instance& inst, DecoderWS& ws, std::mt19937& rng, PortfolioShared& sh, EngineBest& out)
+{
+    const int N = inst.N;
+    const int POP = std::clamp(2 * N, 60, 140);
+    while (!sh.expired()) {
+
+        // запуск до застоя, затем перезапуск с новой популяции
+        Individs pop = init_population(inst, POP, rng, 0.7, ws, 0.2, 1.0);
+        out.evaluations += POP;
+        Individ best = *std::min_element(pop.begin(), pop.end(), better);
+        out.consider(best.perm, best.cmax, sh);
+
+        // потомки хуже рекорда на разброс популяции обрываются; отсечение выше лучшего в запуске, поэтому
+        // обрезанный cmax (нижняя оценка) не выдаётся за улучшение, а в отборе проигрывает точным
+        int stall = 0;
+        while (stall < 50 && !sh.expired()) {
+            const auto [lo, hi] = std::minmax_element(pop.begin(), pop.end(), better);
+            ws.cutoff = std::max(best.cmax + 1, sh.incumbent.get() + (hi->cmax - lo->cmax));
+            pop = next_generation(inst, pop, 3, 3, 0.9, 0.2, rng, ws);
+            ws.cutoff = std::numeric_limits<int>::max();
+            out.evaluations += POP - 3;
+            const Individ& cur = *std::min_element(pop.begin(), pop.end(), better);
+            if (cur.cmax < best.cmax) {
+                best = cur;
+                out.consider(best.perm, best.cmax, sh);
+                stall = 0;
+            } else {
+                ++stall;
+            }
+        }
+
+    }
+}
+
+
+void portfolio_SA(const Instance& inst, DecoderWS& ws, std::mt19937& rng, PortfolioShared& sh, EngineBest& out)
+{
+    const int N = inst.N;
+    std::uniform_real_distribution<double> ur(0.0, 1.0);
+    std::uniform_int_distribution<int> pos(0, std::max(0, N - 1));
+
+    Veci cur = priority_rule_perm(inst, PriorityRule::LFT);
+    int curC = evaluate_cmax(inst, cur, ws);
+    ++out.evaluations;
+    out.consider(cur, curC, sh);
+
+    // температура - в единицах cmax; при остывании - перезапуск из лучшего с нагревом
+    const double T0 = std::max(1.0, 0.05 * curC);
+    double T = T0;
+    const double cooling = 0.9995;
+    Veci cand(N);
+    long long it = 0;
+    while (N > 1) {
+
+        if ((++it & 63) == 0 && sh.expired()) break;
+
+        // вставка: работа с позиции a переносится на позицию b
+        cand = cur;
+        const int a = pos(rng), b = pos(rng);
+        if (a == b) continue;
+        const int job = cand[a];
+        if (a < b) std::move(cand.begin() + a + 1, cand.begin() + b + 1, cand.begin() + a);
+        else std::move_backward(cand.begin() + b, cand.begin() + a, cand.begin() + a + 1);
+        cand[b] = job;
+
+        // ухудшение больше T ln 1000 принимается с вероятностью < 0.001 - такие декодирования обрываются;
+        // запас отсчитывается от общего рекорда, а вдали от него принимаются только не худшие ходы
+        const int slack = (int)std::ceil(T * 6.9078) + 1;
+        const int cutoff = std::max(curC + 1, std::min(curC, sh.incumbent.get()) + slack);
+        ws.cutoff = cutoff;
+        const int c = evaluate_cmax(inst, cand, ws);
+        ws.cutoff = std::numeric_limits<int>::max();
+        ++out.evaluations;
+
+        if (c < cutoff && (c <= curC || ur(rng) < std::exp((curC - c) / T))) {
+            cur.swap(cand);
+            curC = c;
+            out.consider(cur, curC, sh);
+        }
+
+        T *= cooling;
+        if (T < 0.05) {
+            T = T0;
+            cur = out.best.perm;
+            curC = out.best.cmax;
+        }
+
+    }
+}
+
+
+void portfolio_sampler(const Instance& inst, DecoderWS& ws, std::mt19937& rng, PortfolioShared& sh, EngineBest& out)
+{
+    for (long long k = 0; !sh.expired(); ++k) {
+
+        // сначала детерминированные списки, затем выборка; решения не лучше рекорда обрываются
+        const Veci perm = priority_rule_perm(inst, priority_rules[k % priority_rule_count],
+                                             k < priority_rule_count ? nullptr : &rng,
+                                             1.0 + (k / priority_rule_count) % 3);
+        const int inc = sh.incumbent.get();
+        ws.cutoff = out.best.perm.empty() ? std::numeric_limits<int>::max() : inc;
+        const int c = evaluate_cmax(inst, perm, ws);
+        ws.cutoff = std::numeric_limits<int>::max();
+        ++out.evaluations;
+        if (out.best.perm.empty() || c < inc) out.consider(perm, c, sh);
+
+    }
+}
+
+} // namespace
+
+
+PortfolioResult solve_PCPLP_portfolio(Instance inst, PortfolioOptions const& opt)
+{
+    preprocess_instance(inst);
+
+    PortfolioShared sh;
+    sh.deadline = PortfolioClock::now() + std::chrono::duration_cast<PortfolioClock::duration>(
+                                              std::chrono::duration<double>(opt.seconds));
+    sh.lowerBound = lower_bound_cmax(inst);
+
+    const unsigned seed = opt.seed ? opt.seed : std::random_device{}();
+    using EngineFn = void (*)(const Instance&, DecoderWS&, std::mt19937&, PortfolioShared&, EngineBest&);
+    const EngineFn engines[3] = {portfolio_GA, portfolio_SA, portfolio_sampler};
+    const bool enabled[3] = {opt.useGA, opt.useSA, opt.useSampler};
+    if (!enabled[0] && !enabled[1] && !enabled[2]) throw std::invalid_argument("portfolio has no engines enabled");
+
+    // исключение метода останавливает остальные и передаётся вызывающему после join
+    EngineBest results[3];
+    std::exception_ptr errors[3];
+    std::vector<std::thread> pool;
+    for (int e = 0; e < 3; ++e) {
+        if (!enabled[e]) continue;
+        pool.emplace_back([&, e]() {
+            try {
+                DecoderWS ws;
+                init_ws(inst, ws);
+                ws.kind = opt.decoder;
+                std::mt19937 rng(seed + 7919u * e);
+                engines[e](inst, ws, rng, sh, results[e]);
+            } catch (...) {
+                errors[e] = std::current_exception();
+                sh.stop.store(true);
+            }
+        });
+    }
+    for (auto& th : pool) th.join();
+    for (auto const& err : errors)
+        if (err) std::rethrow_exception(err);
+
+    PortfolioResult res;
+    res.lowerBound = sh.lowerBound;
+    res.engineCmax.assign(3, std::numeric_limits<int>::max());
+    res.launched.assign(enabled, enabled + 3);
+    res.evaluations.assign(3, 0);
+    int win = -1;
+    for (int e = 0; e < 3; ++e) {
+        res.evaluations[e] = results[e].evaluations;
+        if (results[e].best.perm.empty()) continue;
+        res.engineCmax[e] = results[e].best.cmax;
+        if (win < 0 || results[e].best.cmax < results[win].best.cmax) win = e;
+    }
+    if (win < 0) throw std::runtime_error("portfolio found no schedule before the deadline");
+
+    res.winner = (PortfolioEngine)win;
+    DecoderWS ws;
+    init_ws(inst, ws);
+    ws.kind = opt.decoder;
+    res.schedule = decode(inst, results[win].best.perm, ws);
+    return res;
+}
 //
\ No newline at end of file
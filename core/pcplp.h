@@ -4,6 +4,9 @@
 
 #include "aux_module.h"
 
+#include <cstdint>
+#include <limits>
+
 
 //структура начальных данных
 struct Instance {
@@ -13,10 +16,17 @@ struct Instance {
     Veci dur;          // вектор продолжительности работ
     Veci rel;          // вектор минимального времени начал работ
     Veci cap;          // вектор объёмов ресурса во время одного временного такта
+    VecVecPairii calendars; // календари мощности: для ресурса m пары (момент, мощность) по возрастанию моментов,
+                            // мощность действует до следующей пары, до первой - cap[m]; пусто - постоянная cap
     VecVecPairii demands; // потребность в ресурсах для каждой работы
     VecVeci preds;     // предшественные работы
     VecVeci succs;     // последующие работы
 
+    // заполняется preprocess_instance
+    Veci topo;         // топологический порядок работ
+    Veci head;         // самое раннее начало по предшествованию и rel (голова)
+    Veci tail;         // длина самого длинного пути от конца работы до конца проекта (хвост)
+
 };
 
 
@@ -33,6 +43,7 @@ struct Individ {
 
     Veci perm;  // порядок выполнения работ
     int cmax=0; // время
+    double fitness=0; // значение цели отбора (для Makespan - cmax)
 
 };
 
@@ -47,10 +58,86 @@ Schedule solve_PCPLP(int N,
                  VecVeci preds);
 
 
+// схема построения расписания по перестановке
+enum class DecoderKind {
+    Serial,   // последовательная (serial SGS): работы по порядку, каждая - в самое раннее допустимое время
+    Parallel, // параллельная (parallel SGS): время растёт по событиям, в каждый момент ставятся все влезающие работы
+    Best      // обе схемы, берётся лучшая
+};
+
+
+// кодирование особей генетического алгоритма
+enum class GAEngine {
+    Permutation, // перестановки: OX-скрещивание и swap-мутация
+    RandomKey    // случайные ключи (BRKGA): порядок - сортировка ключей, элита и мутанты
+};
+
+
+// цель отбора генетического алгоритма
+enum class Objective {
+    Makespan,     // время выполнения cmax
+    SquaredUsage, // сумма квадратов потребления по тактам и ресурсам (выравнивание профиля)
+    MaxPeak,      // наибольшее потребление в долях мощности
+    Overload      // сумма превышений уровня потребления по тактам и ресурсам
+};
+
+
+// неопределённость длительностей: длительность работы j - треугольное распределение на [lo[j], hi[j]]
+// с модой dur[j], округлённое до целого; пустые lo и hi - длительности точные
+struct DurationModel {
+    Veci lo;
+    Veci hi;
+};
+
+
+// параметры решателя
+struct SolveOptions {
+    DecoderKind decoder = DecoderKind::Serial; // декодер перестановок
+    GAEngine engine = GAEngine::Permutation;   // кодирование особей
+    double ruleShare = 0.2;                    // доля начальной популяции из правил приоритета
+    double regretAlpha = 1.0;                  // степень смещения выборки по сожалению (0 - равновероятно)
+    std::string checkpointPath;                // файл контрольной точки (пусто - не писать)
+    int checkpointEvery = 0;                   // писать каждые checkpointEvery поколений, <= 0 - не писать
+    std::string resumeFrom;                    // продолжить с контрольной точки (пусто - с начала)
+    DurationModel durations;                   // неопределённость длительностей для устойчивой цели
+    int robustScenarios = 0;                   // > 0 - особь оценивается квантилем cmax по стольким сценариям
+    double robustQuantile = 0.9;               // уровень этого квантиля
+    unsigned robustSeed = 1;                   // сид сценариев (одни и те же для всех особей)
+    Objective objective = Objective::Makespan; // цель отбора
+    int deadline = 0;                          // срок для целей выравнивания (<= 0 - без срока)
+    double deadlinePenalty = 1e6;              // штраф за такт сверх срока
+    Veci overloadLevel;                        // уровень для Overload по ресурсам (пусто - средняя загрузка до срока)
+    double timeLimit = 0;                      // секунды на поиск (<= 0 - без ограничения), проверяется раз в поколение
+};
+
+
+// решение для готовых начальных данных (последователи строятся, если не заданы)
+Schedule solve_PCPLP(Instance inst, SolveOptions const& opt);
+
+
+Schedule solve_PCPLP(int N,
+                 int M,
+                 Veci dur,
+                 Veci rel,
+                 Veci cap,
+                 VecVecPairii demands,
+                 VecVeci preds,
+                 SolveOptions const& opt);
+
+
 // построение последующих работ
 void build_succs(Instance& inst);
 
 
+// предобработка: проверка индексов и ацикличности (std::invalid_argument), транзитивная редукция дуг
+// (preds и succs заменяются), топологический порядок, головы и хвосты
+void preprocess_instance(Instance& inst);
+
+
+// нижняя оценка cmax: критический путь max(head + dur + tail) и загрузка ресурсов постоянной мощности
+int lower_bound_cmax(const Instance& inst);
+
+
 // построение рандомной перестановки
 Veci make_random_perm(int N, std::mt19937& rng);
 
@@ -63,16 +150,76 @@ using Individs = std::vector<Individ>;
 
 
 
+// до скольких ресурсов декодеры используют специализированные ядра (фиксированные массивы, раскрытые циклы)
+constexpr int max_fixed_resources = 4;
+
+
+// выборка сценариев длительностей
+struct ScenarioSet {
+    int N = 0;  // количество работ
+    int S = 0;  // количество сценариев
+    Veci dur;   // dur[s*N + j]
+};
+
+
+// показатели выравнивания, накапливаются при размещении работ (place_job) по изменённым клеткам usage
+struct LevelStats {
+    bool on = false;      // вести ли учёт (цель не Makespan)
+    Veci level;           // M, уровень, выше которого потребление - перегрузка
+    Vecr invCap;          // M, 1 / cap (с календарями берётся мощность такта)
+    double sumSq = 0;     // сумма квадратов потребления
+    double peak = 0;      // наибольшее потребление в долях мощности
+    double overload = 0;  // сумма превышений level
+};
+
+
 struct DecoderWS {
     int H = 0;
-    VecVeci usage;         // M x H
+    DecoderKind kind = DecoderKind::Serial; // какой схемой декодирует evaluate_cmax
+    Gridi usage;           // H x M, по времени: usage(t, m) ресурсов одного такта лежат подряд
     Schedule S;            // start/finish/cmax
     Veci remPred;          // N
     std::vector<char> done;// N
+    Veci pos;              // N, позиция работы в перестановке (параллельная схема)
+    Veci eligible;         // работы с поставленными предшественниками (параллельная схема)
+    Veci events;           // min-куча моментов окончания (параллельная схема)
+    Gridi demand;          // N x M плотные потребности для ядер с M <= max_fixed_resources (иначе пусто)
+    int cutoff = std::numeric_limits<int>::max(); // отсечение: декодер прерывается, как только окончание работы
+                                                  // достигает cutoff; тогда cmax >= cutoff - лишь нижняя оценка
+    const ScenarioSet* scenarios = nullptr; // не пусто - evaluate_cmax даёт квантиль cmax по сценариям (attach_scenarios)
+    double scenarioQuantile = 0.9;
+    Instance scenario;     // копия данных, в которую подставляются длительности сценария
+    Veci scenarioCmax;     // S
+    Objective objective = Objective::Makespan; // цель evaluate_individ (set_objective)
+    int deadline = 0;
+    double deadlinePenalty = 0;
+    LevelStats level;
+};
+
+// правила приоритета для построения списка работ
+enum class PriorityRule {
+    LFT,  // самое раннее позднее окончание
+    LST,  // самое раннее позднее начало
+    MTS,  // больше всего последователей (всех, не только непосредственных)
+    GRPW, // наибольший ранговый позиционный вес: dur + dur непосредственных последователей
+    RSM   // метод планирования ресурсов: наименьшая задержка остальных готовых работ
 };
 
-// генерация популяции
-Individs init_population(Instance const& inst, int POP, std::mt19937& rng, double topo_share, DecoderWS& ws);
+// все правила по порядку: ими засеваются начальные популяции и перебор портфеля
+constexpr PriorityRule priority_rules[] = {PriorityRule::LFT, PriorityRule::LST, PriorityRule::MTS,
+                                           PriorityRule::GRPW, PriorityRule::RSM};
+constexpr int priority_rule_count = (int)(sizeof(priority_rules) / sizeof(priority_rules[0]));
+
+
+// топологически допустимая перестановка по правилу: rng == nullptr - детерминированно (лучший приоритет),
+// иначе выборка с вероятностью ~ (сожаление + 1)^alpha; требует preprocess_instance (головы и хвосты)
+Veci priority_rule_perm(const Instance& inst, PriorityRule rule, std::mt19937* rng = nullptr, double alpha = 1.0);
+
+
+// генерация популяции: доля rule_share строится правилами приоритета (по одному детерминированному
+// списку на правило, остальные - выборкой по сожалению), из остатка доля topo_share - случайные топологические
+Individs init_population(Instance const& inst, int POP, std::mt19937& rng, double topo_share, DecoderWS& ws,
+                         double rule_share = 0.0, double alpha = 1.0);
 
 
 
@@ -83,6 +230,11 @@ int compute_H(const Instance& inst);
 void init_ws(const Instance& inst, DecoderWS& ws);
 
 
+// то же, что solve_PCPLP(inst, opt), но в переданной рабочей области: буферы переиспользуются между
+// вызовами (долгоживущие процессы)
+Schedule solve_PCPLP(Instance inst, SolveOptions const& opt, DecoderWS& ws);
+
+
 void reset_ws(const Instance& inst, DecoderWS& ws);
 
 
@@ -90,19 +242,51 @@ void reset_ws(const Instance& inst, DecoderWS& ws);
 int evaluate_cmax(const Instance& inst, const Veci& perm, DecoderWS& ws);
 
 
-// usage[m][t] = сколько занято ресурса m в момент t
+// мощность ресурса m в момент t; end - момент, до которого она постоянна
+int capacity_at(const Instance& inst, int m, int t, int& end);
+
+
+// ближайший момент не раньше t, где работа может начаться по найденным конфликтам (t - помещается);
+// при календарях проверка идёт по отрезкам постоянной мощности; std::invalid_argument, если мощности
+// последнего отрезка не хватает на потребность работы
+int next_fit_start(const Instance& inst, int job, int t, const Gridi& usage);
+
+
+// usage(t, m) = сколько занято ресурса m в момент t
 bool can_place(const Instance& inst, int job, int t,
-                      const VecVeci& usage);
+                      const Gridi& usage);
 
 
 void place_job(const Instance& inst, int job, int t,
-                      VecVeci& usage);
+                      Gridi& usage);
+
+// то же с приращением показателей выравнивания
+void place_job(const Instance& inst, int job, int t,
+                      Gridi& usage, LevelStats& st);
 
 
 Schedule serial_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws);
 
 
-// сортировка: меньше cmax — лучше
+// параллельная схема: расписание без задержек (non-delay)
+Schedule parallel_decode_SGS(const Instance& inst, const Veci& perm, DecoderWS& ws);
+
+
+// декодирование схемой ws.kind
+Schedule decode(const Instance& inst, const Veci& perm, DecoderWS& ws);
+
+
+// настройка цели отбора: уровни Overload по умолчанию - средняя загрузка ресурса до срока
+// (без срока - до нижней оценки cmax); экземпляр должен быть предварительно обработан
+void set_objective(const Instance& inst, Objective objective, int deadline, double deadlinePenalty,
+                   Veci const& overloadLevel, DecoderWS& ws);
+
+
+// декодирование особи: cmax и fitness по цели ws.objective (+ штраф за превышение срока)
+void evaluate_individ(const Instance& inst, Individ& ind, DecoderWS& ws);
+
+
+// сортировка: меньше fitness (при равенстве - cmax) — лучше
 bool better(const Individ& a, const Individ& b);
 
 // турнирный отбор: выбрать лучшего из k случайных
@@ -126,4 +310,203 @@ Individs next_generation(
 );
 
 
+// состояние генетического алгоритма для контрольных точек
+struct GAState {
+
+    int generation = 0;  // номер последнего завершённого поколения
+    int stall = 0;       // поколений без улучшения
+    Individ best;        // лучшая особь
+    Individs pop;        // текущая популяция
+    std::string rng;     // состояние генератора (текстовое представление std::mt19937)
+
+};
+
+
+// отпечаток начальных данных (после preprocess_instance): контрольная точка принимается только для той же задачи
+uint64_t instance_fingerprint(const Instance& inst);
+
+
+// запись состояния в двоичный файл (через временный файл и переименование); ошибки - std::runtime_error
+void save_checkpoint(const std::string& path, const Instance& inst, const GAState& st);
+
+
+// чтение состояния; std::runtime_error, если файл повреждён или записан для другой задачи
+GAState load_checkpoint(const std::string& path, const Instance& inst);
+
+
+
+// генетический алгоритм со случайными ключами (BRKGA)
+
+using Vecf = std::vector<float>; // синоним для вектора ключей
+
+
+// особь BRKGA: ключ на каждую работу, порядок декодирования - по возрастанию ключей
+struct KeyIndivid {
+
+    Vecf keys;
+    int cmax = 0;
+
+};
+
+
+using KeyIndivids = std::vector<KeyIndivid>;
+
+
+// параметры BRKGA
+struct BRKGAParams {
+
+    int POP = 100;            // размер популяции
+    int GEN = 300;            // лимит поколений
+    int stall = 50;           // остановка после stall поколений без улучшения
+    double eliteShare = 0.2;  // доля элиты, переходит без изменений
+    double mutantShare = 0.15;// доля мутантов - новых случайных особей
+    double rhoE = 0.7;        // вероятность взять ген от элитного родителя
+    double ruleShare = 0.0;   // доля начальных особей из правил приоритета (ключ - позиция в списке)
+    double regretAlpha = 1.0; // степень смещения выборки по сожалению
+    double timeLimit = 0;     // секунды (<= 0 - без ограничения)
+
+};
+
+
+// буферы поразрядной сортировки ключей
+struct KeySortWS {
+    std::vector<uint32_t> bits, bitsTmp;
+    Veci idxTmp;
+};
+
+
+// порядок работ по возрастанию ключей: LSD-сортировка по байтам битовых образов float (устойчивая)
+void keys_to_perm(const Vecf& keys, Veci& perm, KeySortWS& ks);
+
+
+// смещённое равномерное скрещивание: ген элитного родителя с вероятностью rhoE (выбор без ветвлений)
+void crossover_biased(const Vecf& elite, const Vecf& other, double rhoE, Vecf& child, std::mt19937& rng);
+
+
+// запуск BRKGA, возвращает лучшую особь в виде перестановки
+Individ run_BRKGA(const Instance& inst, const BRKGAParams& prm, std::mt19937& rng, DecoderWS& ws);
+
+
+
+// пакетное декодирование: K перестановок подряд в perms[k*N + j]
+struct DecodeBatchResult {
+
+    int K = 0;
+    int N = 0;
+    Veci cmax;   // cmax[k]
+    Veci start;  // start[k*N + j]; пусто, если времена начала не запрашивались
+
+};
+
+
+// декодировать K перестановок параллельно (у каждой части пакета свой DecoderWS); строки должны быть
+// перестановками 0..N-1, иначе std::invalid_argument; экземпляр предварительно обрабатывается
+DecodeBatchResult decode_batch(Instance inst, const Veci& perms, int K, bool withStarts = false,
+                               DecoderKind kind = DecoderKind::Serial, int threads = 0);
+
+
+
+// устойчивость расписания к длительностям (метод Монте-Карло)
+
+// S сценариев длительностей по модели (std::invalid_argument при lo > dur, hi < dur, lo < 0 или неверных размерах)
+ScenarioSet sample_scenarios(const Instance& inst, const DurationModel& model, int S, unsigned seed);
+
+
+// оценка особей квантилем cmax по сценариям (выборочная средняя аппроксимация); набор должен жить
+// не меньше рабочей области, горизонт usage расширяется под самые длинные сценарии
+void attach_scenarios(const Instance& inst, const ScenarioSet& set, double quantile, DecoderWS& ws);
+
+
+struct RobustnessOptions {
+
+    int scenarios = 1000;                      // количество сценариев
+    unsigned seed = 1;                         // сид выборки
+    Vecr levels{0.5, 0.9, 0.95};               // уровни квантилей
+    DecoderKind decoder = DecoderKind::Serial;
+    int threads = 0;                           // <= 0 - по числу ядер
+
+};
+
+
+struct RobustnessResult {
+
+    Veci cmax;        // cmax по сценариям
+    int nominal = 0;  // cmax при длительностях dur
+    double mean = 0;
+    double stddev = 0;
+    Vecr levels;      // уровни квантилей
+    Vecr quantiles;   // квантили cmax (линейная интерполяция по упорядоченной выборке)
+
+};
+
+
+// распределение cmax перестановки: сценарии декодируются параллельно, по рабочей области на часть выборки
+RobustnessResult simulate_robustness(Instance inst, const Veci& perm, const DurationModel& model,
+                                     RobustnessOptions const& opt);
+
+
+
+// портфель: несколько методов в своих потоках с общим рекордом и общим сроком
+
+// рекорд без блокировок: наименьший найденный cmax (обновляется CAS)
+class Incumbent {
+
+public:
+
+    int get() const { return best.load(std::memory_order_relaxed); }
+
+    // предложить значение, true - рекорд улучшен
+    bool offer(int cmax) {
+        int cur = best.load(std::memory_order_relaxed);
+        while (cmax < cur) {
+            if (best.compare_exchange_weak(cur, cmax, std::memory_order_relaxed)) return true;
+        }
+        return false;
+    }
+
+private:
+
+    std::atomic<int> best{std::numeric_limits<int>::max()};
+
+};
+
+
+enum class PortfolioEngine {
+    GA,       // генетический алгоритм по перестановкам (с перезапусками при застое)
+    SA,       // имитация отжига по перестановке: вставка работы на другую позицию
+    Sampler   // многопроходная выборка по правилам приоритета со смещением по сожалению
+};
+
+
+struct PortfolioOptions {
+
+    double seconds = 10.0;                     // срок для всего портфеля
+    bool useGA = true;
+    bool useSA = true;
+    bool useSampler = true;
+    DecoderKind decoder = DecoderKind::Serial; // декодер всех методов
+    unsigned seed = 0;                         // 0 - случайный
+
+};
+
+
+struct PortfolioResult {
+
+    Schedule schedule;                 // лучшее расписание
+    PortfolioEngine winner = PortfolioEngine::GA; // кто его нашёл
+    Veci engineCmax;                   // лучший cmax каждого метода (GA, SA, Sampler); INT_MAX - решения нет:
+                                       // метод не запускался или портфель остановился раньше его первого решения
+    std::vector<bool> launched;        // запускался ли метод (по PortfolioOptions::use*)
+    std::vector<long long> evaluations;// число декодирований каждого метода
+    int lowerBound = 0;                // нижняя оценка; при cmax == lowerBound портфель останавливается раньше срока
+
+};
+
+
+// портфель методов до срока или до достижения нижней оценки; рекорд общий: все методы отсекают
+// по нему декодирования (DecoderWS::cutoff)
+PortfolioResult solve_PCPLP_portfolio(Instance inst, PortfolioOptions const& opt);
+
+
+
 #endif
\ No newline at end of file
@@ -1,5 +1,9 @@
 #include "rhythmic_delivery.h"
 
+#include <limits>
+#include <stdexcept>
+#include <chrono>
+
 // реализация конструкторов для результатов
 
 DeliveryResult::DeliveryResult(Vecr const& x, Vecr const& V, bool ok) 
@@ -23,67 +27,153 @@ UniformityIterResult::UniformityIterResult(Vecr const& x, Vecr const& V, bool ok
 
 // реализация итерационного метода 
 
-void clamp_vec(Vecr& vec, Vecr const& lb, Vecr const& ub) {
+size_t clamp_vec(Vecr& vec, Vecr const& lb, Vecr const& ub) {
 
+    size_t cnt = 0; // количество срезанных координат
     size_t vec_sz = vec.size();
     for (size_t i = 0; i < vec_sz; ++i) {
 
-        if (vec[i] < lb[i]) vec[i] = lb[i];
-        if (vec[i] > ub[i]) vec[i] = ub[i];
+        if (vec[i] < lb[i]) { vec[i] = lb[i]; ++cnt; }
+        if (vec[i] > ub[i]) { vec[i] = ub[i]; ++cnt; }
 
     }
+    return cnt;
 
 }
 
 
-UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0, double minV, double maxV) {
-
-    const size_t n = p.size(); // количество тактов поставок
+// вычисление трубки lb[t] <= y[t] <= ub[t] для накопленных поставок y[t] = x[0] + ... + x[t], возвращает среднюю поставку Mp
+static double build_tube(Vecr const& p, double V0, double minV, double maxV, Vecr& lb, Vecr& ub) {
 
-    Vecr lb(n, 0.0); // вектор нижних границ
-    Vecr ub(n, 0.0); // вектор верхних границ
+    const size_t n = p.size();
+    lb.assign(n, 0.0);
+    ub.assign(n, 0.0);
 
     double s = 0.0; // сумма поставок из РС потребителям
-    
-
-    // вычисление суммы поставок, нижних и верхних границ поставок в каждый такт
-    for(size_t t = 0; t < n; ++t) {
+    for (size_t t = 0; t < n; ++t) {
 
         s += p[t];             // сумма поставок
         lb[t] = minV - V0 + s; // нижние границы
         ub[t] = maxV - V0 + s; // верхние границы
 
     }
-    double Mp = s / n; // средняя величина поставок
-    //
+    return s / n; // средняя величина поставок
+
+}
 
 
-    // метод проекции градиента
-    bool ok = false;   // флаг того, что метод сошёлся и выполнено принадлежность границам
-    // выбор eps
+// выбор eps по ширине трубки
+static double tube_eps(Vecr const& lb, Vecr const& ub) {
+
     double scale = 0.0;
-    for (size_t i = 0; i < n ; ++i) {
+    for (size_t i = 0; i < lb.size(); ++i) {
         scale = std::max(scale, ub[i] - lb[i]);
     }
-    const double eps = 1e-10 * std::max(1.0, scale);
-    //
+    return 1e-10 * std::max(1.0, scale);
 
-    // оценка порядка O(n^2 * log(scale/eps)); коэффициент с запасом
-    const int maxIter =static_cast<int>(std::ceil( 2.0 * (16.0 * n * n) / (pi * pi) * std::log(1e10)));
+}
 
-    double alpha = 0.125;  // шаг метода 
 
+// градиент F(y) = sum (y[t] - y[t-1] - Mp)^2: g[t] = 2r[t] - 2r[t+1] или 2r[n-1], r[t] = x[t] - Mp
+static void uniform_grad(Vecr const& y, double Mp, Vecr& r, Vecr& g) {
 
-    // код метода
-    // сделаем начальное приближение
-    Vecr y(n, 0.0);
+    const size_t n = y.size();
+
+    r[0] = y[0] - Mp;
+    for (size_t t = 1; t < n; ++t) {
+        r[t] = (y[t] - y[t - 1]) - Mp;
+    }
+
+    for (size_t i = 0; i + 1 < n; ++i) {
+        g[i] = 2.0 * r[i] - 2.0 * r[i + 1];
+    }
+    g[n - 1] = 2.0 * r[n - 1];
+
+}
+
+
+// восстановление x и V по y с проверкой границ склада, возвращает наибольший выход V за границы (0 - в границах)
+static double restore_plan(Vecr const& y, Vecr const& p, double V0, double minV, double maxV, Vecr& x, Vecr& vecV) {
+
+    const size_t n = y.size();
+    x.assign(n, 0.0);
+    vecV.assign(n, 0.0);
+
+    x[0] = y[0];
+    for (size_t t = 1; t < n; ++t) {
+        x[t] = y[t] - y[t - 1];
+    }
+
+    double viol = 0.0;
     for (size_t t = 0; t < n; ++t) {
 
-        // y[t] = (t + 1.0) * Mp; // для задачи из статьи идеальное начальное приближение
-        y[t] = 0.5*(lb[t]+ub[t]); // приближение средними границ
+        vecV[t] = x[t] - p[t] + (t == 0 ? V0 : vecV[t - 1]);
+        viol = std::max(viol, std::max(minV - vecV[t], vecV[t] - maxV));
 
     }
-    clamp_vec(y, lb, ub); // проецирование на множество lb[t]<=y[t]<=ub[t]
+    return viol;
+
+}
+
+
+// значение критерия равномерности F(y) = sum (x[t] - Mp)^2
+static double uniform_objective(Vecr const& y, double Mp) {
+
+    double f = 0.0;
+    for (size_t t = 0; t < y.size(); ++t) {
+        const double r = y[t] - (t == 0 ? 0.0 : y[t - 1]) - Mp;
+        f += r * r;
+    }
+    return f;
+
+}
+
+
+// насколько вектор выходит за трубку (до проекции)
+static double tube_outside(Vecr const& y, Vecr const& lb, Vecr const& ub) {
+
+    double d = 0.0;
+    for (size_t t = 0; t < y.size(); ++t) {
+        d = std::max(d, std::max(lb[t] - y[t], y[t] - ub[t]));
+    }
+    return d;
+
+}
+
+
+// диагностика итераций: число срезок проекцией и прореженная история
+struct IterTrace {
+
+    int every = 0;           // шаг прореживания истории, 0 - без истории
+    long long clamped = 0;   // сколько координат срезала проекция
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    UniformityIterResult* out = nullptr; // куда писать историю
+
+    bool want(int it) const { return every > 0 && out && it % every == 0; }
+
+    void record(int it, Vecr const& y, double Mp, double pgNorm, double outside) {
+        out->histIter.push_back(it);
+        out->histSeconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        out->histObjective.push_back(uniform_objective(y, Mp));
+        out->histPgNorm.push_back(pgNorm);
+        out->histOutside.push_back(outside);
+    }
+
+};
+
+
+// оценка порядка O(n^2 * log(scale/eps)); коэффициент с запасом
+static int uniform_pg_max_iter(size_t n) {
+    return static_cast<int>(std::ceil( 2.0 * (16.0 * n * n) / (pi * pi) * std::log(1e10)));
+}
+
+
+// ядро метода проекции градиента: улучшает допустимое приближение y на месте, возвращает номер последней итерации
+static int uniform_pg_core(Vecr& y, Vecr const& lb, Vecr const& ub, double Mp, double eps, int maxIter, bool& ok,
+                           IterTrace* trace) {
+
+    const size_t n = y.size();
+    double alpha = 0.125;  // шаг метода 
 
     Vecr r(n, 0.0);  // r[t] = x[t] - Mp
     Vecr g(n, 0.0);  // градиент F(y) grad(F)[t] = g[t] = 2r[t] - 2r[t+1] или 2r[n]
@@ -91,28 +181,21 @@ UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0
 
 
     // градиентный спуск
+    ok = false;
     int it = 0;
     for (; it < maxIter; ++it) {
 
-        // вычисление r[t]
-        r[0] = y[0] - Mp;
-        for (int t = 1; t < n; ++t) {
-            r[t] = (y[t] - y[t - 1]) - Mp;
-        }
-        //
-
-        // вычисления градиента
-        for (int i = 0; i < n - 1; ++i) {
-            g[i] = 2.0 * r[i] - 2.0 * r[i + 1];
-        }
-        g[n - 1] = 2.0 * r[n - 1];
-        //
+        uniform_grad(y, Mp, r, g); // вычисления градиента
 
         // шаг метода
-        new_y = y - alpha * g;
-        clamp_vec(new_y, lb, ub); // проецирование нового приближения на допустимое множество
-        double maxDiff = lc_norm(new_y - y); // норма разности
+        eval_into(new_y, y - alpha * g); // без временных векторов
+        const bool rec = trace && trace->want(it);
+        const double outside = rec ? tube_outside(new_y, lb, ub) : 0.0;
+        const size_t cnt = clamp_vec(new_y, lb, ub); // проецирование нового приближения на допустимое множество
+        double maxDiff = max_abs_diff(new_y, y); // норма разности
         std::swap(y, new_y); // меням местами память
+        if (trace) trace->clamped += cnt;
+        if (rec) trace->record(it, y, Mp, maxDiff / alpha, outside);
 
         // критерий остановки
         if (maxDiff < eps) {
@@ -124,36 +207,373 @@ UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0
 
     }
     //
+    return it;
+
+}
+
+
+// гессиан F равен 2 D^T D, D - первая разность с y[-1] = 0;
+// собственные числа D^T D: 2 - 2cos((2k-1)pi/(2n+1)), k = 1..n, отсюда точная константа Липшица
+static double uniform_lipschitz(size_t n) {
+    return 8.0 * std::pow(std::sin((2.0 * n - 1.0) * pi / (4.0 * n + 2.0)), 2);
+}
+
+
+// с ускорением число итераций ~ sqrt(cond) * log(scale/eps) = O(n * log(scale/eps)); коэффициент с запасом
+static int uniform_fista_max_iter(size_t n) {
+    return static_cast<int>(std::ceil(2.0 * (4.0 * n + 2.0) / pi * std::log(1e10)));
+}
+
+
+// ядро FISTA для (1 - beta) F(y) + beta sum (y[t] - mid[t])^2, mid - середина трубки (V на середине склада);
+// beta = 0 - критерий равномерности; улучшает допустимое приближение y на месте, возвращает номер
+// последней итерации, ok - достигнута точность eps
+static int fista_core(Vecr& y, Vecr const& lb, Vecr const& ub, double Mp, double beta, double eps, int maxIter,
+                      bool& ok, IterTrace* trace) {
+
+    const size_t n = y.size();
+    const double alpha = 1.0 / ((1.0 - beta) * uniform_lipschitz(n) + 2.0 * beta); // шаг метода
+
+    Vecr z = y;         // точка экстраполяции
+    Vecr r(n, 0.0);     // r[t] = x[t] - Mp
+    Vecr g(n, 0.0);     // градиент в точке z
+    Vecr new_y(n, 0.0); // новое приближение
+    double tk = 1.0;    // параметр момента Нестерова
+
+    ok = false;
+    int it = 0;
+    for (; it < maxIter; ++it) {
+
+        // шаг проекции градиента из точки экстраполяции
+        uniform_grad(z, Mp, r, g);
+        if (beta > 0.0) {
+            for (size_t t = 0; t < n; ++t) g[t] = (1.0 - beta) * g[t] + 2.0 * beta * (z[t] - 0.5 * (lb[t] + ub[t]));
+        }
+        eval_into(new_y, z - alpha * g);
+        const bool rec = trace && trace->want(it);
+        const double outside = rec ? tube_outside(new_y, lb, ub) : 0.0;
+        const size_t cnt = clamp_vec(new_y, lb, ub);
+        if (trace) trace->clamped += cnt;
+
+        // норма градиентного отображения и условие рестарта (O'Donoghue, Candes):
+        // если шаг z -> new_y направлен против движения new_y - y, момент сбрасывается
+        double maxDiff = 0.0;
+        double dir = 0.0;
+        for (size_t t = 0; t < n; ++t) {
+            maxDiff = std::max(maxDiff, std::abs(new_y[t] - z[t]));
+            dir += (z[t] - new_y[t]) * (new_y[t] - y[t]);
+        }
+        if (dir > 0.0) tk = 1.0;
+
+        // экстраполяция
+        const double tNext = 0.5 * (1.0 + std::sqrt(1.0 + 4.0 * tk * tk));
+        const double mom = (tk - 1.0) / tNext; // коэффициент момента
+        for (size_t t = 0; t < n; ++t) {
+            z[t] = new_y[t] + mom * (new_y[t] - y[t]);
+        }
+        tk = tNext;
+        std::swap(y, new_y);
+        if (rec) trace->record(it, y, Mp, maxDiff / alpha, outside);
+
+        // критерий остановки
+        if (maxDiff < eps) {
+
+            ok = true;
+            break;
+
+        }
 
-    // восстановление x
-    Vecr x(n, 0.0);
-    x[0] = y[0];
-    for (int t = 1; t < n; ++t) {
-        x[t] = y[t] - y[t - 1];
     }
-    //
+    return it;
 
-    Vecr vecV(n, 0.0); // объёмы склада
+}
 
 
-    // проверка границ
-    for (int t = 0; t < n; ++t) {
+// критерий равномерности: ядро с beta = 0, сигнатура как у uniform_pg_core
+static int uniform_fista_core(Vecr& y, Vecr const& lb, Vecr const& ub, double Mp, double eps, int maxIter, bool& ok,
+                              IterTrace* trace) {
+    return fista_core(y, lb, ub, Mp, 0.0, eps, maxIter, ok, trace);
+}
 
-        vecV[t] = x[t] - p[t] + (t == 0 ? V0 : vecV[t - 1]);
-        if (vecV[t] < minV || vecV[t] > maxV) {
-            ok = false;
+
+// начальное приближение: середина трубки или заданные x0 / y0, спроецированные на трубку
+static void initial_guess(Vecr& y, Vecr const& lb, Vecr const& ub, IterOptions const& opt) {
+
+    const size_t n = lb.size();
+    y.assign(n, 0.0);
+    if (!opt.y0.empty()) {
+
+        if (opt.y0.size() != n) throw std::invalid_argument("y0 size must match p");
+        y = opt.y0;
+
+    } else if (!opt.x0.empty()) {
+
+        if (opt.x0.size() != n) throw std::invalid_argument("x0 size must match p");
+        double acc = 0.0;
+        for (size_t t = 0; t < n; ++t) {
+            acc += opt.x0[t];
+            y[t] = acc;
+        }
+
+    } else {
+
+        for (size_t t = 0; t < n; ++t) {
+            // y[t] = (t + 1.0) * Mp; // для задачи из статьи идеальное начальное приближение
+            y[t] = 0.5*(lb[t]+ub[t]); // приближение средними границ
         }
 
     }
-    //
+    clamp_vec(y, lb, ub); // проецирование на множество lb[t]<=y[t]<=ub[t]
 
+}
 
-    return UniformityIterResult{x,
-                          vecV,
-                          ok,
-                          Mp,
-                          maxIter,
-                          it};
+
+// диагностика решения y: цель, норма проекции градиента (с шагом 1/L), выход за границы, срезки, время
+static void fill_diagnostics(UniformityIterResult& res, Vecr const& y, Vecr const& lb, Vecr const& ub, double Mp,
+                             double viol, IterTrace const& trace) {
+
+    const size_t n = y.size();
+    Vecr r(n, 0.0), g(n, 0.0), step(n, 0.0);
+    const double alpha = 1.0 / uniform_lipschitz(n);
+    uniform_grad(y, Mp, r, g);
+    eval_into(step, y - alpha * g);
+    clamp_vec(step, lb, ub);
+    res.objective = uniform_objective(y, Mp);
+    res.pgNorm = max_abs_diff(step, y) / alpha;
+    res.maxViolation = viol;
+    res.clamped = trace.clamped;
+    res.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - trace.start).count();
+
+}
+
+
+// общий код итерационных методов: accelerated - FISTA, иначе обычная проекция градиента
+static UniformityIterResult solve_uniform(Vecr const& p, double V0, double minV, double maxV,
+                                          IterOptions const& opt, bool accelerated) {
+
+    const size_t n = p.size(); // количество тактов поставок
+
+    Vecr lb; // вектор нижних границ
+    Vecr ub; // вектор верхних границ
+    const double Mp = build_tube(p, V0, minV, maxV, lb, ub); // средняя величина поставок
+
+    const double eps = opt.eps > 0.0 ? opt.eps : tube_eps(lb, ub);
+    const int maxIter = opt.maxIter > 0 ? opt.maxIter
+                      : (accelerated ? uniform_fista_max_iter(n) : uniform_pg_max_iter(n));
+    auto core = accelerated ? uniform_fista_core : uniform_pg_core;
+
+    UniformityIterResult res;
+    IterTrace trace;
+    trace.every = opt.historyEvery;
+    trace.out = &res;
+
+    Vecr y;
+    initial_guess(y, lb, ub, opt);
+
+    bool ok = false;   // флаг того, что метод сошёлся и выполнено принадлежность границам
+    const int it = core(y, lb, ub, Mp, eps, maxIter, ok, &trace);
+
+    // восстановление x и проверка границ
+    const double viol = restore_plan(y, p, V0, minV, maxV, res.x, res.V);
+    res.ok = ok && viol <= 0.0;
+    res.Mp = Mp;
+    res.maxIter = maxIter;
+    res.iters = it;
+
+    fill_diagnostics(res, y, lb, ub, Mp, viol, trace);
+
+    // для тёплого старта можно измерить выигрыш: то же решение из середины трубки
+    const bool warm = !opt.x0.empty() || !opt.y0.empty();
+    if (warm && opt.measureSaved) {
+        Vecr yCold;
+        initial_guess(yCold, lb, ub, IterOptions{});
+        bool okCold = false;
+        res.itersSaved = core(yCold, lb, ub, Mp, eps, maxIter, okCold, nullptr) - it;
+    }
+
+    return res;
+
+}
+
+
+UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0, double minV, double maxV) {
+    return solve_uniform(p, V0, minV, maxV, IterOptions{}, false);
+}
+
+
+UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0, double minV, double maxV,
+                                                        IterOptions const& opt) {
+    return solve_uniform(p, V0, minV, maxV, opt, false);
+}
+
+
+// реализация ускоренного метода проекции градиента (FISTA)
+UniformityIterResult solve_rhythmic_delivery_uniform_fista(Vecr const& p, double V0, double minV, double maxV) {
+    return solve_uniform(p, V0, minV, maxV, IterOptions{}, true);
+}
+
+
+UniformityIterResult solve_rhythmic_delivery_uniform_fista(Vecr const& p, double V0, double minV, double maxV,
+                                                           IterOptions const& opt) {
+    return solve_uniform(p, V0, minV, maxV, opt, true);
+}
+//
+
+
+// реализация взвешенного критерия
+
+// решение с заданным начальным приближением y (улучшается на месте)
+static WeightedDeliveryResult solve_weighted(Vecr const& p, double V0, double minV, double maxV, double beta,
+                                             Vecr const& lb, Vecr const& ub, double Mp, IterOptions const& opt, Vecr& y) {
+
+    if (beta < 0.0 || beta > 1.0) throw std::invalid_argument("beta must lie in [0, 1]");
+    const size_t n = p.size();
+    const double eps = opt.eps > 0.0 ? opt.eps : tube_eps(lb, ub);
+    const int maxIter = opt.maxIter > 0 ? opt.maxIter : uniform_fista_max_iter(n);
+
+    WeightedDeliveryResult res;
+    bool ok = false;
+    res.iters = fista_core(y, lb, ub, Mp, beta, eps, maxIter, ok, nullptr);
+    const double viol = restore_plan(y, p, V0, minV, maxV, res.x, res.V);
+    res.ok = ok && viol <= 0.0;
+
+    const double mid = 0.5 * (minV + maxV);
+    res.beta = beta;
+    res.uniformity = uniform_objective(y, Mp);
+    for (size_t t = 0; t < n; ++t) res.storage += (res.V[t] - mid) * (res.V[t] - mid);
+    res.objective = (1.0 - beta) * res.uniformity + beta * res.storage;
+    return res;
+
+}
+
+
+WeightedDeliveryResult solve_rhythmic_delivery_weighted(Vecr const& p, double V0, double minV, double maxV, double beta,
+                                                        IterOptions const& opt) {
+
+    Vecr lb, ub, y;
+    const double Mp = build_tube(p, V0, minV, maxV, lb, ub);
+    initial_guess(y, lb, ub, opt);
+    return solve_weighted(p, V0, minV, maxV, beta, lb, ub, Mp, opt, y);
+
+}
+
+
+std::vector<WeightedDeliveryResult> sweep_rhythmic_delivery_weighted(Vecr const& p, double V0, double minV, double maxV,
+                                                                     Vecr const& betas, IterOptions const& opt) {
+
+    Vecr lb, ub, y;
+    const double Mp = build_tube(p, V0, minV, maxV, lb, ub);
+    initial_guess(y, lb, ub, opt);
+
+    // трубка и приближение общие: соседние веса дают близкие решения, поэтому тёплый старт почти точен
+    std::vector<WeightedDeliveryResult> curve;
+    curve.reserve(betas.size());
+    for (double beta : betas) {
+        curve.push_back(solve_weighted(p, V0, minV, maxV, beta, lb, ub, Mp, opt, y));
+    }
+    return curve;
+
+}
+//
+
+
+// реализация потокового решателя со скользящим горизонтом
+
+RhythmicDeliveryStream::RhythmicDeliveryStream(double V0, double minV, double maxV, int maxIterPerUpdate,
+                                               int maxHorizon)
+    : V0(V0)
+    , minV(minV)
+    , maxV(maxV)
+    , maxIterPerUpdate(maxIterPerUpdate)
+    , maxHorizon(maxHorizon)
+{
+}
+
+
+size_t RhythmicDeliveryStream::horizon() const {
+
+    return maxHorizon > 0 ? std::min(p.size(), (size_t)maxHorizon) : p.size();
+
+}
+
+
+// такты, вошедшие в горизонт, продолжают план средней поставкой горизонта - тёплый старт для нового хвоста
+static void extend_warm_start(std::deque<double>& y, std::deque<double> const& p, size_t H, double shift) {
+
+    if (y.size() >= H) return;
+    double sum = 0.0;
+    for (size_t t = 0; t < H; ++t) sum += p[t];
+    const double Mp = sum / H;
+    double last = y.empty() ? shift : y.back();
+    while (y.size() < H) y.push_back(last += Mp);
+
+}
+
+
+void RhythmicDeliveryStream::push(double pt) {
+
+    p.push_back(pt);
+    solved = false;
+
+}
+
+
+void RhythmicDeliveryStream::revise(size_t t, double pt) {
+
+    p.at(t) = pt;
+    solved = false;
+
+}
+
+
+UniformityIterResult RhythmicDeliveryStream::solve() {
+
+    const size_t n = horizon();
+    if (n == 0) return UniformityIterResult{{}, {}, true, 0.0, 0, 0};
+    IterTrace trace; // время решения и срезки для диагностики
+
+    const Vecr ph(p.begin(), p.begin() + n);
+    const double Mp = build_tube(ph, V0, minV, maxV, lb, ub);
+
+    // прошлое решение в координатах окна проецируется на новую трубку
+    extend_warm_start(y, p, n, shift);
+    yw.resize(n);
+    for (size_t t = 0; t < n; ++t) yw[t] = y[t] - shift;
+    clamp_vec(yw, lb, ub);
+
+    const int fullIter = uniform_fista_max_iter(n);
+    const int maxIter = warm && maxIterPerUpdate > 0 ? std::min(maxIterPerUpdate, fullIter) : fullIter;
+    bool ok = false;
+    const int it = uniform_fista_core(yw, lb, ub, Mp, tube_eps(lb, ub), maxIter, ok, &trace);
+    std::copy(yw.begin(), yw.end(), y.begin());
+    shift = 0.0;
+    solved = warm = true;
+
+    UniformityIterResult res;
+    const double viol = restore_plan(yw, ph, V0, minV, maxV, res.x, res.V);
+    res.ok = ok && viol <= 0.0;
+    res.Mp = Mp;
+    res.maxIter = maxIter;
+    res.iters = it;
+    fill_diagnostics(res, yw, lb, ub, Mp, viol, trace);
+    return res;
+
+}
+
+
+double RhythmicDeliveryStream::advance() {
+
+    if (p.empty()) return 0.0;
+    if (!solved) solve();
+
+    // первый такт выполнен: склад сдвигается, накопленные поставки отсчитываются от нового начала
+    const double x0 = y[0] - shift;
+    V0 += x0 - p[0];
+    shift += x0;
+    y.pop_front();
+    p.pop_front();
+    ++done;
+    return x0;
 
 }
 //
@@ -185,5 +605,920 @@ DeliveryResult solve_rhythmic_delivery_bounds_direct(Vecr const& p, double V0, d
                           vecV,
                           ok};
 
+}
+//
+
+
+// реализация пакетных методов
+
+static void init_batch_result(DeliveryBatch const& batch, DeliveryBatchResult& res) {
+
+    res.K = batch.K;
+    res.n = batch.n;
+    res.x.assign((size_t)batch.K * batch.n, 0.0);
+    res.V.assign((size_t)batch.K * batch.n, 0.0);
+    res.ok.assign(batch.K, 0);
+    res.Mp.assign(batch.K, 0.0);
+    res.iters.assign(batch.K, 0);
+
+}
+
+
+// итерационный метод для блока продуктов [k0, k0 + w): массивы блока по тактам, a[t*W + l]
+static void solve_uniform_block(DeliveryBatch const& batch, int k0, DeliveryBatchResult& res) {
+
+    constexpr int W = batch_lanes;
+    const int n = batch.n;
+    const int w = std::min(W, batch.K - k0); // заполненные полосы, остальные - пустые задачи
+
+    Vecr lb((size_t)n * W, 0.0);
+    Vecr ub((size_t)n * W, 0.0);
+    double Mp[W] = {}, eps[W], tk[W], beta[W], maxDiff[W], dir[W], act[W];
+    int iters[W];
+
+    // трубки и средние поставки по полосам
+    for (int l = 0; l < W; ++l) {
+
+        eps[l] = 1.0;
+        tk[l] = 1.0;
+        act[l] = 0.0;
+        iters[l] = 0;
+        if (l >= w) continue;
+
+        const int k = k0 + l;
+        const double* pk = batch.p.data() + (size_t)k * n;
+        double s = 0.0, scale = 0.0;
+        for (int t = 0; t < n; ++t) {
+            s += pk[t];
+            lb[(size_t)t * W + l] = batch.minV[k] - batch.V0[k] + s;
+            ub[(size_t)t * W + l] = batch.maxV[k] - batch.V0[k] + s;
+            scale = std::max(scale, ub[(size_t)t * W + l] - lb[(size_t)t * W + l]);
+        }
+        Mp[l] = s / n;
+        eps[l] = 1e-10 * std::max(1.0, scale);
+        act[l] = 1.0;
+
+    }
+
+    const double alpha = 1.0 / uniform_lipschitz(n);
+    const int maxIter = uniform_fista_max_iter(n);
+
+    Vecr y((size_t)n * W);
+    for (size_t i = 0; i < y.size(); ++i) y[i] = 0.5 * (lb[i] + ub[i]);
+    clamp_vec(y, lb, ub);
+    Vecr z = y;
+    Vecr r((size_t)n * W, 0.0);
+    Vecr new_y((size_t)n * W, 0.0);
+
+    int active = w;
+    for (int it = 0; it < maxIter && active > 0; ++it) {
+
+        // r и градиент в z, шаг и проекция - все внутренние циклы по полосам
+        for (int l = 0; l < W; ++l) r[l] = z[l] - Mp[l];
+        for (int t = 1; t < n; ++t) {
+            for (int l = 0; l < W; ++l) {
+                r[(size_t)t * W + l] = z[(size_t)t * W + l] - z[(size_t)(t - 1) * W + l] - Mp[l];
+            }
+        }
+        for (int l = 0; l < W; ++l) { maxDiff[l] = 0.0; dir[l] = 0.0; }
+        for (int t = 0; t < n; ++t) {
+            const size_t i = (size_t)t * W;
+            for (int l = 0; l < W; ++l) {
+                const double g = 2.0 * r[i + l] - (t + 1 < n ? 2.0 * r[i + W + l] : 0.0);
+                const double v = std::min(std::max(z[i + l] - alpha * g, lb[i + l]), ub[i + l]);
+                new_y[i + l] = v;
+                maxDiff[l] = std::max(maxDiff[l], std::abs(v - z[i + l]));
+                dir[l] += (z[i + l] - v) * (v - y[i + l]);
+            }
+        }
+
+        // рестарт и момент по полосам, сошедшиеся полосы замораживаются
+        for (int l = 0; l < W; ++l) {
+            if (dir[l] > 0.0) tk[l] = 1.0;
+            const double tNext = 0.5 * (1.0 + std::sqrt(1.0 + 4.0 * tk[l] * tk[l]));
+            beta[l] = (tk[l] - 1.0) / tNext;
+            tk[l] = tNext;
+        }
+        for (int t = 0; t < n; ++t) {
+            const size_t i = (size_t)t * W;
+            for (int l = 0; l < W; ++l) {
+                const double v = y[i + l] + act[l] * (new_y[i + l] - y[i + l]);
+                z[i + l] = v + act[l] * beta[l] * (v - y[i + l]);
+                y[i + l] = v;
+            }
+        }
+        for (int l = 0; l < w; ++l) {
+            if (act[l] != 0.0 && maxDiff[l] < eps[l]) {
+                act[l] = 0.0;
+                iters[l] = it;
+                --active;
+            }
+        }
+
+    }
+
+    // восстановление x, V по продуктам
+    for (int l = 0; l < w; ++l) {
+
+        const int k = k0 + l;
+        const size_t off = (size_t)k * n;
+        double curV = batch.V0[k];
+        bool ok = act[l] == 0.0;
+        for (int t = 0; t < n; ++t) {
+            const double xt = y[(size_t)t * W + l] - (t == 0 ? 0.0 : y[(size_t)(t - 1) * W + l]);
+            curV += xt - batch.p[off + t];
+            res.x[off + t] = xt;
+            res.V[off + t] = curV;
+            if (curV < batch.minV[k] || curV > batch.maxV[k]) ok = false;
+        }
+        res.ok[k] = ok;
+        res.Mp[k] = Mp[l];
+        res.iters[k] = act[l] == 0.0 ? iters[l] : maxIter;
+
+    }
+
+}
+
+
+DeliveryBatchResult solve_rhythmic_delivery_uniform_batch(DeliveryBatch const& batch, int threads) {
+
+    DeliveryBatchResult res;
+    init_batch_result(batch, res);
+    if (batch.n == 0) return res;
+
+    const int blocks = (batch.K + batch_lanes - 1) / batch_lanes;
+    parallel_for(blocks, [&](int b) { solve_uniform_block(batch, b * batch_lanes, res); }, threads);
+    return res;
+
+}
+
+
+DeliveryBatchResult solve_rhythmic_delivery_bounds_direct_batch(DeliveryBatch const& batch, int threads) {
+
+    DeliveryBatchResult res;
+    init_batch_result(batch, res);
+
+    constexpr int W = batch_lanes;
+    const int n = batch.n;
+    const int blocks = (batch.K + W - 1) / W;
+
+    parallel_for(blocks, [&](int b) {
+
+        const int k0 = b * W;
+        const int w = std::min(W, batch.K - k0); // заполненные полосы, остальные - пустые задачи
+        double curV[W] = {}, meanV[W] = {};
+        for (int l = 0; l < w; ++l) {
+            const int k = k0 + l;
+            curV[l] = batch.V0[k];
+            meanV[l] = 0.5 * (batch.minV[k] + batch.maxV[k]);
+            res.ok[k] = (batch.V0[k] >= batch.minV[k] && batch.V0[k] <= batch.maxV[k]);
+        }
+
+        // блок перекладывается по тактам (t * W + l) кусками по chunk тактов, помещающимися в кэш,
+        // чтобы внутренний цикл по полосам шёл подряд
+        constexpr int chunk = 256;
+        double pt[chunk * W] = {}, xt[chunk * W], Vt[chunk * W];
+        for (int t0 = 0; t0 < n; t0 += chunk) {
+
+            const int len = std::min(chunk, n - t0);
+            for (int l = 0; l < w; ++l) {
+                const double* pk = batch.p.data() + (size_t)(k0 + l) * n + t0;
+                for (int t = 0; t < len; ++t) pt[t * W + l] = pk[t];
+            }
+
+            // рекуррентность по тактам, внутри такта - по всем полосам блока
+            for (int t = 0; t < len; ++t) {
+                const int i = t * W;
+                for (int l = 0; l < W; ++l) {
+                    const double x = std::max(0.0, meanV[l] - (curV[l] - pt[i + l]));
+                    curV[l] += x - pt[i + l];
+                    xt[i + l] = x;
+                    Vt[i + l] = curV[l];
+                }
+            }
+
+            for (int l = 0; l < w; ++l) {
+                const size_t off = (size_t)(k0 + l) * n + t0;
+                for (int t = 0; t < len; ++t) {
+                    res.x[off + t] = xt[t * W + l];
+                    res.V[off + t] = Vt[t * W + l];
+                }
+            }
+
+        }
+
+    }, threads);
+
+    return res;
+
+}
+//
+
+
+// реализация обобщённого метода
+
+// кусочно-линейная невозрастающая функция уровня Z(lam): значение Vleft при lam -> -inf, Vright при lam -> +inf,
+// в точках излома наклон меняется на ds; изломы лежат в min- и max-кучах с ленивым удалением,
+// кучи перестраиваются, когда удалённых в них становится больше живых; номер излома освобождается
+// после удаления из обеих куч, так что память пропорциональна числу живых изломов, а не длине горизонта
+class LevelFunction {
+
+public:
+
+    double Vleft = 0.0;
+    double Vright = 0.0;
+
+    void add(double lam, double d) {
+        int id;
+        if (freeIds.empty()) {
+            id = (int)ds.size();
+            ds.push_back(d);
+            alive.push_back(1);
+            refs.push_back(2);
+        }
+        else {
+            id = freeIds.back();
+            freeIds.pop_back();
+            ds[id] = d;
+            alive[id] = 1;
+            refs[id] = 2;
+        }
+        ++aliveCnt;
+        lo.push_back({lam, id});
+        std::push_heap(lo.begin(), lo.end(), Greater());
+        hi.push_back({lam, id});
+        std::push_heap(hi.begin(), hi.end(), Less());
+    }
+
+    bool peek_min(double& lam) { return peek(lo, Greater(), lam); }
+    bool peek_max(double& lam) { return peek(hi, Less(), lam); }
+    double pop_min() { return pop(lo, Greater()); }
+    double pop_max() { return pop(hi, Less()); }
+
+private:
+
+    struct Node { double lam; int id; };
+    struct Greater { bool operator()(Node const& a, Node const& b) const { return a.lam > b.lam; } };
+    struct Less { bool operator()(Node const& a, Node const& b) const { return a.lam < b.lam; } };
+
+    // узел покинул одну из куч
+    void unref(int id) {
+        if (--refs[id] == 0) freeIds.push_back(id);
+    }
+
+    template <class Cmp>
+    bool peek(std::vector<Node>& heap, Cmp cmp, double& lam) {
+        if (heap.size() > 2 * (size_t)aliveCnt + 64) {
+            heap.erase(std::remove_if(heap.begin(), heap.end(), [&](Node const& nd) {
+                if (alive[nd.id]) return false;
+                unref(nd.id);
+                return true;
+            }), heap.end());
+            std::make_heap(heap.begin(), heap.end(), cmp);
+        }
+        while (!heap.empty() && !alive[heap.front().id]) {
+            unref(heap.front().id);
+            std::pop_heap(heap.begin(), heap.end(), cmp);
+            heap.pop_back();
+        }
+        if (heap.empty()) return false;
+        lam = heap.front().lam;
+        return true;
+    }
+
+    template <class Cmp>
+    double pop(std::vector<Node>& heap, Cmp cmp) {
+        const int id = heap.front().id;
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        heap.pop_back();
+        alive[id] = 0;
+        --aliveCnt;
+        unref(id);
+        return ds[id];
+    }
+
+    Vecr ds;
+    std::vector<char> alive;
+    std::vector<char> refs; // в скольких кучах ещё лежит узел
+    Veci freeIds;
+    int aliveCnt = 0;
+    std::vector<Node> lo;
+    std::vector<Node> hi;
+
+};
+
+
+// Z = min(Z, U): возвращает уровень a, левее которого Z = U (-inf, если срезки нет, +inf, если Z > U всюду)
+static double clip_upper(LevelFunction& F, double U) {
+
+    const double inf = std::numeric_limits<double>::infinity();
+    if (F.Vleft <= U) return -inf;
+
+    double v = F.Vleft; // значение в pos
+    double s = 0.0;     // наклон правее pos
+    double pos = -inf;
+    double lam;
+    while (F.peek_min(lam)) {
+
+        if (s < 0.0) {
+            const double vAt = v + s * (lam - pos);
+            if (vAt <= U) {
+                const double a = pos + (U - v) / s;
+                F.Vleft = U;
+                F.add(a, s);
+                return a;
+            }
+            v = vAt;
+        }
+        pos = lam;
+        s += F.pop_min();
+
+    }
+
+    // изломов не осталось: Z постоянна и выше U - такт невыполним
+    F.Vleft = F.Vright = v;
+    return inf;
+
+}
+
+
+// Z = max(Z, L): возвращает уровень b, правее которого Z = L (+inf, если срезки нет, -inf, если Z < L всюду)
+static double clip_lower(LevelFunction& F, double L) {
+
+    const double inf = std::numeric_limits<double>::infinity();
+    if (F.Vright >= L) return inf;
+
+    double v = F.Vright; // значение в pos
+    double s = 0.0;      // наклон левее pos
+    double pos = inf;
+    double lam;
+    while (F.peek_max(lam)) {
+
+        if (s < 0.0) {
+            const double vAt = v - s * (pos - lam);
+            if (vAt >= L) {
+                const double b = pos + (L - v) / s;
+                F.Vright = L;
+                F.add(b, -s);
+                return b;
+            }
+            v = vAt;
+        }
+        pos = lam;
+        s -= F.pop_max();
+
+    }
+
+    F.Vleft = F.Vright = v;
+    return -inf;
+
+}
+
+
+// размеры векторов задачи: minV, maxV - по тактам, необязательные - пустые или по тактам
+static void check_problem(DeliveryProblem const& prob) {
+
+    const size_t n = prob.p.size();
+    if (prob.minV.size() != n) throw std::invalid_argument("minV size must match p");
+    if (prob.maxV.size() != n) throw std::invalid_argument("maxV size must match p");
+    const std::pair<Vecr const*, const char*> optional[] = {
+        {&prob.xmin, "xmin"}, {&prob.xmax, "xmax"}, {&prob.w, "w"},
+        {&prob.target, "target"}, {&prob.cost, "cost"}, {&prob.hold, "hold"}};
+    for (auto const& [v, name] : optional)
+        if (!v->empty() && v->size() != n) throw std::invalid_argument(std::string(name) + " must be empty or match p");
+    for (double wt : prob.w)
+        if (!(wt > 0.0)) throw std::invalid_argument("w must be positive");
+
+}
+
+
+DeliveryQPResult solve_rhythmic_delivery_general(DeliveryProblem const& prob) {
+
+    check_problem(prob);
+    const size_t n = prob.p.size();
+    const double inf = std::numeric_limits<double>::infinity();
+    auto at = [](Vecr const& v, size_t t, double def) { return v.empty() ? def : v[t]; };
+
+    DeliveryQPResult res;
+    res.ok = true;
+    if (n == 0) return res;
+
+    // трубка по y, средняя поставка
+    Vecr lb(n), ub(n);
+    double s = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+        s += prob.p[t];
+        lb[t] = prob.minV[t] - prob.V0 + s;
+        ub[t] = prob.maxV[t] - prob.V0 + s;
+    }
+    const double Mp = s / n;
+
+    // линейные слагаемые переносятся в цель: hold[t]V[t] даёт x[s] коэффициент sum_{t >= s} hold[t]
+    Vecr w(n), m(n), xlo(n), xhi(n);
+    double holdSuffix = 0.0;
+    for (size_t t = n; t-- > 0;) {
+        holdSuffix += at(prob.hold, t, 0.0);
+        w[t] = at(prob.w, t, 1.0);
+        m[t] = at(prob.target, t, Mp) - (at(prob.cost, t, 0.0) + holdSuffix) / (2.0 * w[t]);
+
+        // бесконечные границы x заменяются следствиями трубки с запасом, чтобы все изломы были конечны,
+        // а новые границы никогда не были активны (допустимое множество и множители не меняются)
+        const double lPrev = t == 0 ? 0.0 : lb[t - 1];
+        const double uPrev = t == 0 ? 0.0 : ub[t - 1];
+        const double slack = 1.0 + (ub[t] - lb[t]) + (uPrev - lPrev);
+        xlo[t] = std::max(at(prob.xmin, t, 0.0), lb[t] - uPrev - slack);
+        xhi[t] = std::min(at(prob.xmax, t, inf), ub[t] - lPrev + slack);
+        if (xlo[t] > xhi[t]) {
+            res.ok = false;
+            xhi[t] = xlo[t];
+        }
+    }
+
+    // прямой проход: Y_t(lam) = clip(Y_{t-1}(lam) + X_t(lam), lb[t], ub[t]),
+    // X_t(lam) = clip(m[t] - lam/(2w[t]), xlo[t], xhi[t]); запоминаются только уровни срезок a[t] <= b[t]
+    Vecr a(n), b(n);
+    LevelFunction F;
+    for (size_t t = 0; t < n; ++t) {
+
+        const double k = 1.0 / (2.0 * w[t]);
+        F.Vleft += xhi[t];
+        F.Vright += xlo[t];
+        F.add(2.0 * w[t] * (m[t] - xhi[t]), -k);
+        F.add(2.0 * w[t] * (m[t] - xlo[t]), k);
+
+        a[t] = clip_upper(F, ub[t]);
+        b[t] = clip_lower(F, lb[t]);
+        if (a[t] == inf || b[t] == -inf) {
+            res.ok = false;
+            a[t] = b[t] = (a[t] == inf ? inf : -inf);
+        }
+
+    }
+
+    // обратный проход: конец свободен (уровень 0), уровень меняется только на срезках
+    res.level.assign(n, 0.0);
+    res.x.assign(n, 0.0);
+    double lam = 0.0;
+    for (size_t t = n; t-- > 0;) {
+        lam = std::max(a[t], std::min(b[t], lam));
+        res.level[t] = lam;
+        res.x[t] = std::min(std::max(m[t] - lam / (2.0 * w[t]), xlo[t]), xhi[t]);
+    }
+
+    // V, проверка границ и значение цели
+    res.V.assign(n, 0.0);
+    double curV = prob.V0;
+    for (size_t t = 0; t < n; ++t) {
+
+        curV += res.x[t] - prob.p[t];
+        res.V[t] = curV;
+        // допуск учитывает накопление округлений в сумме x на длинных горизонтах
+        const double tol = 1e-9 * std::max(1.0, std::abs(prob.maxV[t] - prob.minV[t])) + 1e-12 * std::abs(ub[t]);
+        if (curV < prob.minV[t] - tol || curV > prob.maxV[t] + tol) res.ok = false;
+        if (res.x[t] < at(prob.xmin, t, 0.0) - tol || res.x[t] > at(prob.xmax, t, inf) + tol) res.ok = false;
+
+        const double d = res.x[t] - at(prob.target, t, Mp);
+        res.objective += at(prob.w, t, 1.0) * d * d + at(prob.cost, t, 0.0) * res.x[t] + at(prob.hold, t, 0.0) * curV;
+
+    }
+
+    return res;
+
+}
+//
+
+
+// реализация отчёта о чувствительности
+
+DeliverySensitivity solve_rhythmic_delivery_sensitivity(DeliveryProblem const& prob) {
+
+    DeliverySensitivity res;
+    static_cast<DeliveryQPResult&>(res) = solve_rhythmic_delivery_general(prob);
+    const size_t n = prob.p.size();
+    if (n == 0) return res;
+    auto at = [](Vecr const& v, size_t t, double def) { return v.empty() ? def : v[t]; };
+
+    double Mp = 0.0;
+    for (size_t t = 0; t < n; ++t) Mp += prob.p[t];
+    Mp /= n;
+
+    // цель зависит от p[s] через сдвиг трубки (-L[s]), через V в стоимости хранения (-sum_{t >= s} hold[t])
+    // и, если желаемая поставка не задана, через среднюю поставку: dMp/dp[s] = 1/n
+    double dMp = 0.0;
+    if (prob.target.empty()) {
+        for (size_t t = 0; t < n; ++t) dMp -= 2.0 * at(prob.w, t, 1.0) * (res.x[t] - Mp);
+    }
+
+    res.multiplier.assign(n, 0.0);
+    res.dObj_dp.assign(n, 0.0);
+    res.dObj_dminV.assign(n, 0.0);
+    res.dObj_dmaxV.assign(n, 0.0);
+    double holdSuffix = 0.0;
+    for (size_t t = n; t-- > 0;) {
+        holdSuffix += at(prob.hold, t, 0.0);
+        const double mu = res.level[t] - (t + 1 < n ? res.level[t + 1] : 0.0);
+        res.multiplier[t] = mu;
+        res.dObj_dmaxV[t] = -std::max(mu, 0.0);
+        res.dObj_dminV[t] = -std::min(mu, 0.0);
+        res.dObj_dp[t] = -res.level[t] - holdSuffix + dMp / n;
+    }
+    // V0 сдвигает трубку в обратную сторону и все V
+    res.dObj_dV0 = res.level[0] + holdSuffix;
+
+    for (size_t t = 0; t < n; ++t) {
+        const double tol = 1e-9 * std::max(1.0, std::abs(prob.maxV[t] - prob.minV[t]));
+        if (res.V[t] <= prob.minV[t] + tol) res.atMin.push_back((int)t);
+        if (res.V[t] >= prob.maxV[t] - tol) res.atMax.push_back((int)t);
+    }
+
+    return res;
+
+}
+//
+
+
+// реализация метода во внешней памяти
+
+MappedDeliveryResult solve_rhythmic_delivery_uniform_mapped(std::string const& pPath, std::string const& xPath,
+                                                            std::string const& VPath, double V0, double minV, double maxV) {
+
+    const double inf = std::numeric_limits<double>::infinity();
+    const size_t chunk = (size_t)1 << 20; // тактов между возвратом страниц
+
+    MappedFile pf(pPath);
+    if (pf.size() % sizeof(double) != 0) throw std::invalid_argument("p file size is not a multiple of double");
+    const size_t n = pf.size() / sizeof(double);
+    MappedFile xf(xPath, n * sizeof(double));
+    MappedFile Vf(VPath, n * sizeof(double));
+
+    MappedDeliveryResult res;
+    res.n = n;
+    res.ok = true;
+    if (n == 0) return res;
+
+    const double* p = static_cast<const double*>(pf.data());
+    double* x = static_cast<double*>(xf.data());
+    double* V = static_cast<double*>(Vf.data());
+    auto release = [&](MappedFile& f, size_t from, size_t to) { f.release(from * sizeof(double), (to - from) * sizeof(double)); };
+
+    // средняя поставка
+    double total = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+        total += p[t];
+        if ((t + 1) % chunk == 0) release(pf, t + 1 - chunk, t + 1);
+    }
+    const double Mp = total / n;
+    res.Mp = Mp;
+
+    // границы x из трубки с запасом (никогда не активны), как в обобщённом методе
+    auto x_bounds = [](double lb, double ub, double lPrev, double uPrev, double& xlo, double& xhi) {
+        const double slack = 1.0 + (ub - lb) + (uPrev - lPrev);
+        xlo = lb - uPrev - slack;
+        xhi = ub - lPrev + slack;
+    };
+
+    // прямой проход: уровни срезок a[t] -> x[t], b[t] -> V[t]
+    LevelFunction F;
+    double s = 0.0, lPrev = 0.0, uPrev = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+
+        s += p[t];
+        const double lb = minV - V0 + s;
+        const double ub = maxV - V0 + s;
+        double xlo, xhi;
+        x_bounds(lb, ub, lPrev, uPrev, xlo, xhi);
+
+        F.Vleft += xhi;
+        F.Vright += xlo;
+        F.add(2.0 * (Mp - xhi), -0.5);
+        F.add(2.0 * (Mp - xlo), 0.5);
+
+        double a = clip_upper(F, ub);
+        double b = clip_lower(F, lb);
+        if (a == inf || b == -inf) {
+            res.ok = false;
+            a = b = (a == inf ? inf : -inf);
+        }
+        x[t] = a;
+        V[t] = b;
+        lPrev = lb;
+        uPrev = ub;
+
+        if ((t + 1) % chunk == 0) {
+            release(pf, t + 1 - chunk, t + 1);
+            release(xf, t + 1 - chunk, t + 1);
+            release(Vf, t + 1 - chunk, t + 1);
+        }
+
+    }
+
+    // обратный проход: уровни -> x; накопленное потребление восстанавливается вычитанием
+    double lam = 0.0;
+    for (size_t t = n; t-- > 0;) {
+
+        const double lb = minV - V0 + s;
+        const double ub = maxV - V0 + s;
+        s -= p[t];
+        const double lPrevT = t == 0 ? 0.0 : minV - V0 + s;
+        const double uPrevT = t == 0 ? 0.0 : maxV - V0 + s;
+        double xlo, xhi;
+        x_bounds(lb, ub, lPrevT, uPrevT, xlo, xhi);
+
+        lam = std::max(x[t], std::min(V[t], lam));
+        x[t] = std::min(std::max(Mp - lam / 2.0, xlo), xhi);
+
+        if ((n - t) % chunk == 0) {
+            release(pf, t, t + chunk);
+            release(xf, t, t + chunk);
+            release(Vf, t, t + chunk);
+        }
+
+    }
+
+    // V, проверка границ и значение критерия
+    double curV = V0;
+    s = 0.0;
+    for (size_t t = 0; t < n; ++t) {
+
+        s += p[t];
+        curV += x[t] - p[t];
+        V[t] = curV;
+        const double tol = 1e-9 * std::max(1.0, std::abs(maxV - minV)) + 1e-12 * std::abs(maxV - V0 + s);
+        if (curV < minV - tol || curV > maxV + tol) res.ok = false;
+        res.objective += (x[t] - Mp) * (x[t] - Mp);
+
+        if ((t + 1) % chunk == 0) {
+            release(pf, t + 1 - chunk, t + 1);
+            release(xf, t + 1 - chunk, t + 1);
+            release(Vf, t + 1 - chunk, t + 1);
+        }
+
+    }
+
+    return res;
+
+}
+//
+
+
+// реализация дискретного метода
+
+// f_cur[K] = min_{K' <= K} f_prev[K'] + (lot (K - K') - Mp)^2 для K из [kLo, kHi] (номера - смещения от lo0 / lo1);
+// оптимальный K' не убывает по K, поэтому отрезок кандидатов делится пополам вместе с отрезком K
+static void lots_transition(Vecr const& fPrev, long long prevLo, long long prevHi,
+                            Vecr& fCur, long long curLo, Span<int> arg,
+                            long long kLo, long long kHi, long long optLo, long long optHi,
+                            double lot, double Mp) {
+
+    if (kLo > kHi) return;
+    const long long K = kLo + (kHi - kLo) / 2;
+
+    double best = std::numeric_limits<double>::infinity();
+    long long bestK = optLo;
+    const long long last = std::min(optHi, std::min(K, prevHi));
+    for (long long Kp = optLo; Kp <= last; ++Kp) {
+        const double d = lot * (K - Kp) - Mp;
+        const double v = fPrev[Kp - prevLo] + d * d;
+        if (v < best) {
+            best = v;
+            bestK = Kp;
+        }
+    }
+    fCur[K - curLo] = best;
+    arg[K - curLo] = (int)(bestK - prevLo);
+
+    lots_transition(fPrev, prevLo, prevHi, fCur, curLo, arg, kLo, K - 1, optLo, bestK, lot, Mp);
+    lots_transition(fPrev, prevLo, prevHi, fCur, curLo, arg, K + 1, kHi, bestK, optHi, lot, Mp);
+
+}
+
+
+LotDeliveryResult solve_rhythmic_delivery_lots(Vecr const& p, double V0, double minV, double maxV, double lot) {
+
+    if (!(lot > 0.0)) throw std::invalid_argument("lot must be positive");
+
+    const size_t n = p.size();
+    LotDeliveryResult res;
+    res.ok = true;
+    res.lots.assign(n, 0);
+    if (n == 0) return res;
+
+    // допустимые накопленные числа партий K_t: V_t = V0 - P_t + lot K_t в [minV, maxV], K_t >= K_{t-1};
+    // достижимые K_t образуют отрезок [lo[t], hi[t]]
+    std::vector<long long> lo(n), hi(n);
+    double P = 0.0;
+    long long prevLo = 0;
+    size_t width = 1;
+    for (size_t t = 0; t < n; ++t) {
+
+        P += p[t];
+        const long long kLo = (long long)std::ceil((minV - V0 + P) / lot - 1e-9);
+        const long long kHi = (long long)std::floor((maxV - V0 + P) / lot + 1e-9);
+        lo[t] = std::max(kLo, prevLo);
+        hi[t] = kHi;
+        if (lo[t] > hi[t]) {
+            res.ok = false;
+            break;
+        }
+        prevLo = lo[t];
+        width = std::max(width, (size_t)(hi[t] - lo[t] + 1));
+
+    }
+    res.Mp = P / n;
+    if (!res.ok) {
+        // невыполнимо: без поставок, V показывает, где нарушаются границы
+        res.x.assign(n, 0.0);
+        res.V.assign(n, 0.0);
+        double curV = V0;
+        for (size_t t = 0; t < n; ++t) res.V[t] = curV = curV - p[t];
+        return res;
+    }
+
+    // прямой ход
+    Gridi arg(n, width, 0);
+    Vecr fPrev{0.0}; // K_{-1} = 0
+    Vecr fCur;
+    long long pLo = 0, pHi = 0;
+    for (size_t t = 0; t < n; ++t) {
+        fCur.assign((size_t)(hi[t] - lo[t] + 1), 0.0);
+        lots_transition(fPrev, pLo, pHi, fCur, lo[t], arg.row(t), lo[t], hi[t], pLo, pHi, lot, res.Mp);
+        std::swap(fPrev, fCur);
+        pLo = lo[t];
+        pHi = hi[t];
+    }
+
+    // конец свободен: лучшее состояние последнего такта, затем обратный ход
+    size_t k = (size_t)(std::min_element(fPrev.begin(), fPrev.end()) - fPrev.begin());
+    res.objective = fPrev[k];
+    std::vector<long long> K(n);
+    for (size_t t = n; t-- > 0;) {
+        K[t] = lo[t] + (long long)k;
+        k = (size_t)arg(t, k);
+    }
+
+    res.x.assign(n, 0.0);
+    res.V.assign(n, 0.0);
+    double curV = V0;
+    for (size_t t = 0; t < n; ++t) {
+        res.lots[t] = (int)(K[t] - (t == 0 ? 0 : K[t - 1]));
+        res.x[t] = lot * res.lots[t];
+        res.V[t] = curV = curV + res.x[t] - p[t];
+    }
+
+    return res;
+
+}
+//
+
+
+// реализация общего склада
+
+// взвешенная изотонная регрессия (невозрастающая, PAVA) с последующей срезкой снизу нулём
+static void project_nonincreasing(Vecr& v, Vecr const& wt) {
+
+    const size_t n = v.size();
+    Vecr sum, wsum;   // блоки: взвешенная сумма и вес
+    Veci len;
+    for (size_t t = 0; t < n; ++t) {
+        sum.push_back(wt[t] * v[t]);
+        wsum.push_back(wt[t]);
+        len.push_back(1);
+        // сливаем, пока среднее предыдущего блока меньше среднего последнего
+        while (sum.size() > 1 && sum[sum.size() - 2] / wsum[wsum.size() - 2] < sum.back() / wsum.back()) {
+            sum[sum.size() - 2] += sum.back();
+            wsum[wsum.size() - 2] += wsum.back();
+            len[len.size() - 2] += len.back();
+            sum.pop_back();
+            wsum.pop_back();
+            len.pop_back();
+        }
+    }
+
+    size_t t = 0;
+    for (size_t b = 0; b < sum.size(); ++b) {
+        const double mean = std::max(0.0, sum[b] / wsum[b]);
+        for (int k = 0; k < len[b]; ++k) v[t++] = mean;
+    }
+
+}
+
+
+SharedWarehouseResult solve_shared_warehouse(SharedWarehouseProblem const& prob, int maxIter, double tol, int threads) {
+
+    SharedWarehouseResult res;
+    const int K = (int)prob.products.size();
+    if (K == 0) {
+        res.ok = true;
+        return res;
+    }
+    const size_t n = prob.products[0].p.size();
+    for (auto const& pr : prob.products) {
+        if (pr.p.size() != n) throw std::invalid_argument("all products must share the horizon length");
+        check_problem(pr);
+    }
+    if (prob.maxVTotal.size() != 1 && prob.maxVTotal.size() != n) {
+        throw std::invalid_argument("maxVTotal must have 1 or n values");
+    }
+    auto cap = [&](size_t t) { return prob.maxVTotal.size() == 1 ? prob.maxVTotal[0] : prob.maxVTotal[t]; };
+
+    // цена mu[t] >= 0 задаётся суффиксными суммами nu[s] = sum_{t >= s} mu[t] (невозрастающие, >= 0):
+    // в подзадаче nu[s] сдвигает только x_i[s] с наклоном 1/(2 w_i[s]), поэтому кривизна двойственной функции
+    // по nu ограничена диагональю curv[s] = sum_i 1/(2 w_i[s]) - это и шаг, и метрика проекции
+    Vecr curv(n, 0.0);
+    for (auto const& pr : prob.products) {
+        for (size_t t = 0; t < n; ++t) curv[t] += 0.5 / (pr.w.empty() ? 1.0 : pr.w[t]);
+    }
+
+    std::vector<DeliveryProblem> sub = prob.products;
+    std::vector<DeliveryQPResult> part(K);
+    Vecr excess(n, 0.0); // sum_i V_i[t] - cap[t]
+    Vecr planNu(n, 0.0); // nu, при которых получены текущие планы part
+
+    // потоки создаются один раз на все итерации подъёма
+    if (threads <= 0) threads = (int)std::thread::hardware_concurrency();
+    ThreadPool workers(std::max(1, std::min(threads, K)));
+
+    // решение подзадач при заданных nu, возвращает наибольшее превышение вместимости
+    auto evaluate = [&](Vecr const& nu) {
+
+        planNu = nu;
+        workers.run(K, [&](int i) {
+            DeliveryProblem& pr = sub[i];
+            pr.hold.assign(n, 0.0);
+            for (size_t t = 0; t < n; ++t) {
+                const double mu = nu[t] - (t + 1 < n ? nu[t + 1] : 0.0);
+                pr.hold[t] = (prob.products[i].hold.empty() ? 0.0 : prob.products[i].hold[t]) + mu;
+            }
+            part[i] = solve_rhythmic_delivery_general(pr);
+        });
+
+        double worst = 0.0;
+        for (size_t t = 0; t < n; ++t) {
+            double total = 0.0;
+            for (int i = 0; i < K; ++i) total += part[i].V[t];
+            excess[t] = total - cap(t);
+            worst = std::max(worst, excess[t]);
+        }
+        return worst;
+
+    };
+
+    // ускоренный проецированный подъём по nu
+    Vecr nu(n, 0.0), z(n, 0.0), nuNew(n, 0.0);
+    double scale = 1.0;
+    for (size_t t = 0; t < n; ++t) scale = std::max(scale, std::abs(cap(t)));
+    double tk = 1.0;
+
+    int it = 0;
+    double worst = 0.0;
+    bool converged = false;
+    for (; it < maxIter; ++it) {
+
+        worst = evaluate(z);
+
+        // градиент по nu[s]: excess[s] - excess[s-1]
+        for (size_t t = 0; t < n; ++t) {
+            const double g = excess[t] - (t == 0 ? 0.0 : excess[t - 1]);
+            nuNew[t] = z[t] + g / curv[t];
+        }
+        project_nonincreasing(nuNew, curv);
+
+        double step = 0.0, dir = 0.0;
+        for (size_t t = 0; t < n; ++t) {
+            step = std::max(step, std::abs(nuNew[t] - z[t]) * curv[t]); // в единицах объёма
+            dir += curv[t] * (z[t] - nuNew[t]) * (nuNew[t] - nu[t]);
+        }
+        std::swap(nu, nuNew);
+
+        // планы в точке z выполнимы и цена почти неподвижна - останавливаемся на них
+        if (worst <= tol * scale && step <= tol * scale) {
+            converged = true;
+            ++it;
+            break;
+        }
+
+        if (dir > 0.0) tk = 1.0;
+        const double tNext = 0.5 * (1.0 + std::sqrt(1.0 + 4.0 * tk * tk));
+        const double beta = (tk - 1.0) / tNext;
+        for (size_t t = 0; t < n; ++t) z[t] = nu[t] + beta * (nu[t] - nuNew[t]);
+        tk = tNext;
+
+    }
+
+    // без сходимости - итоговые планы при последней цене; цена в ответе - та, при которой получены планы
+    if (!converged) worst = evaluate(nu);
+    res.maxExcess = std::max(0.0, worst);
+    res.iters = it;
+    res.price.assign(n, 0.0);
+    res.totalV.assign(n, 0.0);
+    for (size_t t = 0; t < n; ++t) {
+        res.price[t] = planNu[t] - (t + 1 < n ? planNu[t + 1] : 0.0);
+        res.totalV[t] = excess[t] + cap(t);
+    }
+    res.ok = res.maxExcess <= tol * scale;
+    for (int i = 0; i < K; ++i) res.ok = res.ok && part[i].ok;
+    res.products = std::move(part);
+    return res;
+
 }
 //
\ No newline at end of file
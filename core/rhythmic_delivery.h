@@ -4,6 +4,8 @@
 
 #include "aux_module.h"
 
+#include <deque>
+
 // класс результата для прямого метода
 struct DeliveryResult {
 
@@ -21,6 +23,21 @@ struct UniformityIterResult : DeliveryResult {
     double Mp;       // средняя поставка (для критерия равномерности)
     int maxIter;     // лимит итераций
     int iters;       // сколько реально сделали итераций
+    int itersSaved = -1; // на сколько итераций меньше, чем из середины трубки (-1 - не измерялось)
+
+    // диагностика
+    double seconds = 0.0;      // время решения, с
+    double objective = 0.0;    // F = sum (x[t] - Mp)^2
+    double pgNorm = 0.0;       // l_inf норма проекции градиента в решении
+    double maxViolation = 0.0; // наибольший выход V за [minV, maxV]
+    long long clamped = 0;     // сколько координат срезала проекция за все итерации
+
+    // прореженная история (IterOptions::historyEvery)
+    Veci histIter;       // номера итераций
+    Vecr histSeconds;    // время от начала решения
+    Vecr histObjective;  // F
+    Vecr histPgNorm;     // норма градиентного отображения
+    Vecr histOutside;    // насколько шаг градиента вышел за трубку до проекции
 
     UniformityIterResult()=default;
     UniformityIterResult(Vecr const& x, Vecr const& V, bool ok, double Mp, int maxIter, int iters);
@@ -29,17 +46,265 @@ struct UniformityIterResult : DeliveryResult {
 
 // функции для метода проекции градиента
 
-// функция проекции вектора на многомерный куб задаваемый векторами lb, ub
-void clamp_vec(Vecr& vec, Vecr const& lb, Vecr const& ub);
+// функция проекции вектора на многомерный куб задаваемый векторами lb, ub, возвращает число срезанных координат
+size_t clamp_vec(Vecr& vec, Vecr const& lb, Vecr const& ub);
+
+
+// параметры итерационных методов
+struct IterOptions {
+
+    Vecr x0;                   // начальные поставки (тёплый старт), пусто - середина трубки
+    Vecr y0;                   // или начальные накопленные поставки, приоритетнее x0
+    double eps = 0.0;          // точность по норме шага, <= 0 - 1e-10 * ширина трубки
+    int maxIter = 0;           // лимит итераций, <= 0 - оценка по n
+    bool measureSaved = false; // при тёплом старте решить ещё раз из середины трубки и заполнить itersSaved
+    int historyEvery = 0;      // писать историю каждые historyEvery итераций, 0 - не писать
+
+};
 
 
 // итерационный метод решения задачи о равномерных поставках, критерий: равномерности. PG - проекция градиента
 UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0, double minV, double maxV);
 
+
+// то же с начальным приближением (проецируется на трубку), точностью и лимитом итераций
+UniformityIterResult solve_rhythmic_delivery_uniform_pg(Vecr const& p, double V0, double minV, double maxV,
+                                                        IterOptions const& opt);
+
+
+// ускоренный метод проекции градиента (FISTA) с точным шагом 1/L и рестартом по градиенту, критерий: равномерности
+UniformityIterResult solve_rhythmic_delivery_uniform_fista(Vecr const& p, double V0, double minV, double maxV);
+
+
+UniformityIterResult solve_rhythmic_delivery_uniform_fista(Vecr const& p, double V0, double minV, double maxV,
+                                                           IterOptions const& opt);
+
+
+
+// результат взвешенного критерия
+struct WeightedDeliveryResult : DeliveryResult {
+
+    double beta = 0.0;       // вес критерия склада
+    double uniformity = 0.0; // sum (x[t] - Mp)^2
+    double storage = 0.0;    // sum (V[t] - (minV + maxV)/2)^2
+    double objective = 0.0;  // (1 - beta) * uniformity + beta * storage
+    int iters = 0;           // итерации FISTA
+
+};
+
+
+// взвешенный критерий (1 - beta) * равномерность + beta * близость V к середине склада, 0 <= beta <= 1;
+// FISTA с шагом 1/((1 - beta) L + 2 beta), начальное приближение - как в IterOptions
+WeightedDeliveryResult solve_rhythmic_delivery_weighted(Vecr const& p, double V0, double minV, double maxV, double beta,
+                                                        IterOptions const& opt = IterOptions{});
+
+
+// кривая компромисса по весам betas (в заданном порядке): каждое решение стартует с предыдущего
+std::vector<WeightedDeliveryResult> sweep_rhythmic_delivery_weighted(Vecr const& p, double V0, double minV, double maxV,
+                                                                     Vecr const& betas, IterOptions const& opt = IterOptions{});
+
+// потоковый решатель со скользящим горизонтом: значения p[t] поступают каждый такт,
+// решение переоптимизируется FISTA с тёплым стартом от предыдущего плана; оптимизируются только
+// первые maxHorizon тактов окна, так что обновление стоит O(maxHorizon * maxIterPerUpdate) независимо
+// от длины окна; остальные такты ждут в окне, пока не войдут в горизонт
+class RhythmicDeliveryStream {
+
+public:
+
+    // maxIterPerUpdate - лимит итераций обновления с тёплым стартом (<= 0 - как у solve_rhythmic_delivery_uniform_fista),
+    // первое решение - с полным лимитом; maxHorizon <= 0 - горизонт не ограничен
+    RhythmicDeliveryStream(double V0, double minV, double maxV, int maxIterPerUpdate = 200, int maxHorizon = 256);
+
+    void push(double pt);             // добавить такт в конец окна
+    void revise(size_t t, double pt); // исправить p[t], t - номер такта от начала окна
+    UniformityIterResult solve();     // переоптимизация на горизонте (x и V - по тактам горизонта)
+    double advance();                 // выполнить первый такт окна, возвращает его поставку
+
+    Vecr window() const { return Vecr(p.begin(), p.end()); } // текущие p окна
+    size_t horizon() const;                   // сколько тактов окна оптимизируется
+    double storage() const { return V0; }     // объём склада перед первым тактом окна
+    long long committed() const { return done; } // сколько тактов уже выполнено
+
+private:
+
+    double V0;            // объём склада перед первым тактом окна
+    double minV;
+    double maxV;
+    int maxIterPerUpdate; // лимит итераций на одно обновление с тёплым стартом
+    int maxHorizon;       // длина оптимизируемой части окна
+    std::deque<double> p; // потребление в тактах окна
+    std::deque<double> y; // накопленные поставки горизонта плюс shift - тёплый старт
+    double shift = 0.0;   // сдвиг y: выполненные поставки вычитаются при следующем solve, а не в advance
+    Vecr lb, ub, yw;      // буферы горизонта
+    bool solved = false;  // y соответствует текущему окну
+    bool warm = false;    // было хотя бы одно решение
+    long long done = 0;   // количество выполненных тактов
+
+};
+
 //
 
 
 
+// пакетное решение для K продуктов с одинаковым горизонтом n: массивы K x n построчно по продуктам,
+// внутри блоки по batch_lanes продуктов хранятся по тактам, чтобы циклы по продуктам векторизовались
+constexpr int batch_lanes = 8;
+
+struct DeliveryBatch {
+
+    int K = 0;  // количество продуктов
+    int n = 0;  // количество тактов
+    Vecr p;     // p[k*n + t]
+    Vecr V0;    // начальный объём склада по продуктам
+    Vecr minV;  // нижняя граница склада по продуктам
+    Vecr maxV;  // верхняя граница склада по продуктам
+
+};
+
+
+struct DeliveryBatchResult {
+
+    int K = 0;
+    int n = 0;
+    Vecr x;                // x[k*n + t]
+    Vecr V;                // V[k*n + t]
+    std::vector<char> ok;  // выполнимость по продуктам
+    Vecr Mp;               // средняя поставка (для итерационного метода)
+    Veci iters;            // итерации (для итерационного метода)
+
+};
+
+
+// пакетный итерационный метод (FISTA по продуктам в блоке), блоки решаются параллельно
+DeliveryBatchResult solve_rhythmic_delivery_uniform_batch(DeliveryBatch const& batch, int threads = 0);
+
+
+// пакетный прямой метод, блоки решаются параллельно
+DeliveryBatchResult solve_rhythmic_delivery_bounds_direct_batch(DeliveryBatch const& batch, int threads = 0);
+
+
+
+// обобщённая задача о равномерных поставках:
+// min sum w[t](x[t] - target[t])^2 + cost[t]x[t] + hold[t]V[t],
+// minV[t] <= V[t] <= maxV[t], xmin[t] <= x[t] <= xmax[t], V[t] = V0 + x[0] + ... + x[t] - p[0] - ... - p[t]
+// пустые векторы: w = 1, target = средняя поставка, xmin = 0, xmax = +inf, cost = hold = 0
+struct DeliveryProblem {
+
+    Vecr p;          // потребление по тактам
+    double V0 = 0.0; // начальный объём склада
+    Vecr minV;       // нижние границы склада по тактам (конечные)
+    Vecr maxV;       // верхние границы склада по тактам (конечные)
+    Vecr xmin;       // нижние границы поставки
+    Vecr xmax;       // верхние границы поставки (ограничение мощности доставки)
+    Vecr w;          // веса равномерности (> 0)
+    Vecr target;     // желаемая поставка
+    Vecr cost;       // стоимость единицы поставки
+    Vecr hold;       // стоимость хранения единицы объёма
+
+};
+
+
+// результат обобщённой задачи
+struct DeliveryQPResult : DeliveryResult {
+
+    double objective = 0.0; // значение целевой функции
+    Vecr level;             // двойственный уровень L[t]: x[t] = clip(target[t] - (L[t] + cost[t] + ...)/(2w[t]));
+                            // L[t] - L[t+1] - множитель границы склада в такте t (> 0 - maxV, < 0 - minV)
+
+};
+
+
+// точный метод для обобщённой задачи: гессиан по y трёхдиагональный (цепочка тактов), поэтому
+// задача решается прямым проходом по функциям "уровень -> накопленная поставка" и обратным
+// восстановлением уровней, O(n log n)
+DeliveryQPResult solve_rhythmic_delivery_general(DeliveryProblem const& prob);
+
+
+
+// отчёт о чувствительности: активные границы склада, их множители и производные цели по данным
+struct DeliverySensitivity : DeliveryQPResult {
+
+    Veci atMin;         // такты, где V[t] на minV[t]
+    Veci atMax;         // такты, где V[t] на maxV[t]
+    Vecr multiplier;    // множитель границы склада в такте t (> 0 - maxV, < 0 - minV)
+    Vecr dObj_dp;       // производная цели по p[t]
+    Vecr dObj_dminV;    // производная цели по minV[t] (= -min(multiplier, 0))
+    Vecr dObj_dmaxV;    // производная цели по maxV[t] (= -max(multiplier, 0))
+    double dObj_dV0 = 0.0;
+
+};
+
+
+// решение обобщённой задачи с отчётом о чувствительности; производные получаются из двойственных уровней
+// без повторных решений (теорема об огибающей), в вырожденных точках - односторонние
+DeliverySensitivity solve_rhythmic_delivery_sensitivity(DeliveryProblem const& prob);
+
+
+// несколько продуктов на общем складе: sum_i V_i[t] <= maxVTotal[t]
+struct SharedWarehouseProblem {
+
+    std::vector<DeliveryProblem> products; // задачи продуктов с одинаковым горизонтом
+    Vecr maxVTotal;                        // общая вместимость по тактам (один элемент - постоянная)
+
+};
+
+
+struct SharedWarehouseResult {
+
+    std::vector<DeliveryQPResult> products; // планы продуктов
+    Vecr price;             // множители общей вместимости по тактам (цена хранения)
+    Vecr totalV;            // суммарный объём склада
+    double maxExcess = 0.0; // наибольшее превышение общей вместимости
+    int iters = 0;          // итерации двойственного подъёма
+    bool ok = false;        // все продукты выполнимы и вместимость соблюдена
+
+};
+
+
+// декомпозиция по продуктам: двойственный подъём (FISTA) по цене хранения, подзадачи - обобщённый метод
+// с hold += price, решаются параллельно; шаг - по точной диагональной оценке кривизны в переменных
+// суффиксных сумм цены, проекция - изотонная регрессия
+SharedWarehouseResult solve_shared_warehouse(SharedWarehouseProblem const& prob, int maxIter = 500,
+                                             double tol = 1e-6, int threads = 0);
+
+
+
+// результат дискретного метода: поставки кратны размеру партии
+struct LotDeliveryResult : DeliveryResult {
+
+    Veci lots;              // количество партий по тактам
+    double objective = 0.0; // sum (x[t] - Mp)^2
+    double Mp = 0.0;        // средняя поставка
+
+};
+
+
+// дискретный метод: x[t] = lot * k[t], k[t] >= 0 целые, V в границах склада, критерий равномерности;
+// динамическое программирование по накопленному числу партий, переход - min-plus свёртка с выпуклым
+// ядром, поэтому оптимальный предок монотонен и ищется "разделяй и властвуй" за O(S log S) на такт
+LotDeliveryResult solve_rhythmic_delivery_lots(Vecr const& p, double V0, double minV, double maxV, double lot);
+
+
+
+// результат метода во внешней памяти: сами x и V записаны в файлы
+struct MappedDeliveryResult {
+
+    size_t n = 0;           // длина горизонта
+    double Mp = 0.0;        // средняя поставка
+    double objective = 0.0; // критерий равномерности sum (x[t] - Mp)^2
+    bool ok = false;
+
+};
+
+
+// критерий равномерности для очень длинных горизонтов: p читается из файла сырых double (родной порядок байт),
+// x и V пишутся в отображаемые файлы той же длины (x и V в них же служат буфером уровней срезок);
+// точный прямой проход обобщённого метода и обратный проход - последовательные, просмотренные страницы
+// возвращаются ядру, так что резидентная память определяется числом живых изломов, а не длиной горизонта
+MappedDeliveryResult solve_rhythmic_delivery_uniform_mapped(std::string const& pPath, std::string const& xPath,
+                                                            std::string const& VPath, double V0, double minV, double maxV);
+
+
 // прямой метод решения задачи о равномерных поставках, критерий: содержание объёма ресурса в границах объёма склада
 DeliveryResult solve_rhythmic_delivery_bounds_direct(Vecr const& p, double V0, double minV, double maxV);
 
@@ -0,0 +1,279 @@
+#include "solver_protocol.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+
+// реализация протокола сервера решателей
+
+namespace {
+
+// запись чисел подряд в строку
+class ByteWriter {
+
+public:
+
+    template <class T>
+    void put(T v) {
+        const size_t at = buf.size();
+        buf.resize(at + sizeof(T));
+        std::memcpy(&buf[at], &v, sizeof(T));
+    }
+
+    template <class T>
+    void put_vec(std::vector<T> const& v) {
+        put<int32_t>((int32_t)v.size());
+        const size_t at = buf.size();
+        buf.resize(at + v.size() * sizeof(T));
+        if (!v.empty()) std::memcpy(&buf[at], v.data(), v.size() * sizeof(T));
+    }
+
+    std::string take() { return std::move(buf); }
+
+private:
+
+    std::string buf;
+
+};
+
+
+// чтение чисел подряд; выход за конец - std::invalid_argument
+class ByteReader {
+
+public:
+
+    explicit ByteReader(std::string const& s) : p(s.data()), end(s.data() + s.size()) {}
+
+    template <class T>
+    T get() {
+        need(sizeof(T));
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    template <class T>
+    std::vector<T> get_vec() {
+        const int32_t n = get<int32_t>();
+        if (n < 0) throw std::invalid_argument("negative vector length in frame");
+        need((size_t)n * sizeof(T));
+        std::vector<T> v(n);
+        if (n > 0) std::memcpy(v.data(), p, (size_t)n * sizeof(T));
+        p += (size_t)n * sizeof(T);
+        return v;
+    }
+
+    void finish() const {
+        if (p != end) throw std::invalid_argument("trailing bytes in frame");
+    }
+
+private:
+
+    void need(size_t n) const {
+        if ((size_t)(end - p) < n) throw std::invalid_argument("truncated frame");
+    }
+
+    const char* p;
+    const char* end;
+
+};
+
+} // namespace
+
+
+void write_header(char* out, FrameHeader const& h)
+{
+    std::memcpy(out, protocol_magic, 4);
+    std::memcpy(out + 4, &protocol_version, 2);
+    std::memcpy(out + 6, &h.type, 2);
+    std::memcpy(out + 8, &h.id, 4);
+    std::memcpy(out + 12, &h.deadlineMs, 4);
+    std::memcpy(out + 16, &h.bytes, 4);
+}
+
+
+FrameHeader read_header(const char* in)
+{
+    if (std::memcmp(in, protocol_magic, 4) != 0) throw std::invalid_argument("bad frame magic");
+    uint16_t version = 0;
+    std::memcpy(&version, in + 4, 2);
+    if (version != protocol_version) throw std::invalid_argument("unsupported protocol version");
+
+    FrameHeader h;
+    std::memcpy(&h.type, in + 6, 2);
+    std::memcpy(&h.id, in + 8, 4);
+    std::memcpy(&h.deadlineMs, in + 12, 4);
+    std::memcpy(&h.bytes, in + 16, 4);
+    if (h.bytes > max_frame_body) throw std::invalid_argument("frame body too large");
+    return h;
+}
+
+
+uint32_t max_request_body(uint16_t type)
+{
+    switch ((MsgType)type) {
+    case MsgType::PCPLP:
+    case MsgType::Delivery:
+        return max_frame_body;
+    default:
+        return 0;
+    }
+}
+
+
+std::string make_frame(FrameHeader h, std::string const& body)
+{
+    h.bytes = (uint32_t)body.size();
+    std::string out(frame_header_size, '\0');
+    write_header(&out[0], h);
+    out += body;
+    return out;
+}
+//
+
+
+// тела запросов
+
+std::string encode_pcplp_request(PCPLPRequest const& req)
+{
+    const Instance& inst = req.inst;
+    ByteWriter w;
+    w.put<int32_t>(inst.N);
+    w.put<int32_t>(inst.M);
+    w.put_vec(inst.dur);
+    w.put_vec(inst.rel);
+    w.put_vec(inst.cap);
+    for (int j = 0; j < inst.N; ++j) {
+        w.put<int32_t>((int32_t)inst.demands[j].size());
+        for (auto [m, qty] : inst.demands[j]) {
+            w.put<int32_t>(m);
+            w.put<int32_t>(qty);
+        }
+    }
+    for (int j = 0; j < inst.N; ++j) w.put_vec(inst.preds[j]);
+    w.put<int32_t>((int32_t)req.decoder);
+    w.put<int32_t>((int32_t)req.engine);
+    w.put<int32_t>((int32_t)req.objective);
+    w.put<int32_t>(req.deadline);
+    return w.take();
+}
+
+
+PCPLPRequest decode_pcplp_request(std::string const& body)
+{
+    ByteReader r(body);
+    PCPLPRequest req;
+    Instance& inst = req.inst;
+    inst.N = r.get<int32_t>();
+    inst.M = r.get<int32_t>();
+    if (inst.N <= 0 || inst.M < 0) throw std::invalid_argument("instance must have jobs and a non-negative resource count");
+    inst.dur = r.get_vec<int32_t>();
+    inst.rel = r.get_vec<int32_t>();
+    inst.cap = r.get_vec<int32_t>();
+    if ((int)inst.dur.size() != inst.N || (int)inst.rel.size() != inst.N || (int)inst.cap.size() != inst.M)
+        throw std::invalid_argument("instance vectors do not match N and M");
+    for (const Veci* v : {&inst.dur, &inst.rel, &inst.cap})
+        if (std::any_of(v->begin(), v->end(), [](int x) { return x < 0; }))
+            throw std::invalid_argument("negative duration, release or capacity");
+
+    inst.demands.resize(inst.N);
+    for (int j = 0; j < inst.N; ++j) {
+        const int32_t cnt = r.get<int32_t>();
+        if (cnt < 0 || cnt > inst.M) throw std::invalid_argument("bad demand count");
+        for (int k = 0; k < cnt; ++k) {
+            const int m = r.get<int32_t>();
+            const int qty = r.get<int32_t>();
+            if (m < 0 || m >= inst.M || qty < 0) throw std::invalid_argument("bad demand of job " + std::to_string(j));
+            inst.demands[j].push_back({m, qty});
+        }
+    }
+    inst.preds.resize(inst.N);
+    for (int j = 0; j < inst.N; ++j) inst.preds[j] = r.get_vec<int32_t>();
+
+    const int decoder = r.get<int32_t>(), engine = r.get<int32_t>(), objective = r.get<int32_t>();
+    if (decoder < 0 || decoder > (int)DecoderKind::Best || engine < 0 || engine > (int)GAEngine::RandomKey ||
+        objective < 0 || objective > (int)Objective::Overload)
+        throw std::invalid_argument("bad solver options");
+    req.decoder = (DecoderKind)decoder;
+    req.engine = (GAEngine)engine;
+    req.objective = (Objective)objective;
+    req.deadline = r.get<int32_t>();
+    r.finish();
+    return req;
+}
+
+
+std::string encode_delivery_request(DeliveryProblem const& prob)
+{
+    ByteWriter w;
+    w.put_vec(prob.p);
+    w.put<double>(prob.V0);
+    for (const Vecr* v : {&prob.minV, &prob.maxV, &prob.xmin, &prob.xmax, &prob.w, &prob.target, &prob.cost, &prob.hold})
+        w.put_vec(*v);
+    return w.take();
+}
+
+
+DeliveryProblem decode_delivery_request(std::string const& body)
+{
+    ByteReader r(body);
+    DeliveryProblem prob;
+    prob.p = r.get_vec<double>();
+    prob.V0 = r.get<double>();
+    for (Vecr* v : {&prob.minV, &prob.maxV, &prob.xmin, &prob.xmax, &prob.w, &prob.target, &prob.cost, &prob.hold})
+        *v = r.get_vec<double>();
+    r.finish();
+    return prob; // размеры векторов проверяет решатель (std::invalid_argument)
+}
+//
+
+
+// тела ответов
+
+std::string encode_pcplp_response(Schedule const& s)
+{
+    ByteWriter w;
+    w.put<int32_t>(s.cmax);
+    w.put_vec(s.start);
+    w.put_vec(s.finish);
+    return w.take();
+}
+
+
+Schedule decode_pcplp_response(std::string const& body)
+{
+    ByteReader r(body);
+    Schedule s;
+    s.cmax = r.get<int32_t>();
+    s.start = r.get_vec<int32_t>();
+    s.finish = r.get_vec<int32_t>();
+    r.finish();
+    return s;
+}
+
+
+std::string encode_delivery_response(DeliveryQPResult const& res)
+{
+    ByteWriter w;
+    w.put<int32_t>(res.ok ? 1 : 0);
+    w.put<double>(res.objective);
+    w.put_vec(res.x);
+    w.put_vec(res.V);
+    return w.take();
+}
+
+
+DeliveryQPResult decode_delivery_response(std::string const& body)
+{
+    ByteReader r(body);
+    DeliveryQPResult res;
+    res.ok = r.get<int32_t>() != 0;
+    res.objective = r.get<double>();
+    res.x = r.get_vec<double>();
+    res.V = r.get_vec<double>();
+    r.finish();
+    return res;
+}
+//
@@ -0,0 +1,102 @@
+#ifndef SOLVER_PROTOCOL_H
+#define SOLVER_PROTOCOL_H
+
+
+#include "pcplp.h"
+#include "rhythmic_delivery.h"
+
+#include <cstdint>
+#include <string>
+
+
+// двоичный протокол сервера решателей (solver_daemon)
+//
+// кадр: заголовок 20 байт + тело; числа - int32 / uint32 / uint16 / float64 как в памяти (little-endian)
+//   magic "PCSD", uint16 версия, uint16 тип (запрос - MsgType, ответ - Status),
+//   uint32 номер запроса (ответ несёт номер запроса), uint32 срок в мс от получения (0 - без срока),
+//   uint32 длина тела
+// векторы: int32 длина, затем элементы
+//
+// тела запросов:
+//   Ping     - пусто
+//   PCPLP    - N, M, dur, rel, cap, для каждой работы: число пар и пары (ресурс, количество),
+//              для каждой работы: предшественники (вектор), затем int32 decoder, engine, objective, deadline
+//   Delivery - p, V0 (float64), minV, maxV, xmin, xmax, w, target, cost, hold (пустые - по умолчанию)
+// тела ответов (Status::Ok):
+//   Ping     - пусто
+//   PCPLP    - cmax, start, finish
+//   Delivery - int32 ok, float64 objective, x, V
+// при другом статусе тело - текст ошибки
+
+constexpr char protocol_magic[4] = {'P', 'C', 'S', 'D'};
+constexpr uint16_t protocol_version = 1;
+constexpr size_t frame_header_size = 20;
+constexpr uint32_t max_frame_body = 256u << 20; // больше - ошибка протокола
+
+
+enum class MsgType : uint16_t {
+    Ping = 0,
+    PCPLP = 1,
+    Delivery = 2
+};
+
+
+enum class Status : uint16_t {
+    Ok = 0,
+    BadRequest = 1,      // тело не разобрано или данные неверны
+    DeadlineExpired = 2, // срок истёк до начала решения
+    Failed = 3           // ошибка при решении
+};
+
+
+struct FrameHeader {
+
+    uint16_t type = 0;        // MsgType или Status
+    uint32_t id = 0;          // номер запроса
+    uint32_t deadlineMs = 0;  // срок в мс от получения, 0 - без срока
+    uint32_t bytes = 0;       // длина тела
+
+};
+
+
+// запрос планирования: данные и основные параметры решателя
+struct PCPLPRequest {
+
+    Instance inst;
+    DecoderKind decoder = DecoderKind::Serial;
+    GAEngine engine = GAEngine::Permutation;
+    Objective objective = Objective::Makespan;
+    int deadline = 0; // срок для целей выравнивания
+
+};
+
+
+// заголовок: запись в 20 байт и разбор (std::invalid_argument при неверных magic, версии или длине)
+void write_header(char* out, FrameHeader const& h);
+FrameHeader read_header(const char* in);
+
+// наибольшая длина тела запроса данного типа: Ping - 0, неизвестный тип - 0
+uint32_t max_request_body(uint16_t type);
+
+
+// тела кадров; разбор бросает std::invalid_argument на обрезанных или лишних данных, а запрос планирования -
+// и на пустой задаче, отрицательных данных или потребностях в несуществующих ресурсах; размеры векторов
+// задачи поставки проверяет сам решатель
+std::string encode_pcplp_request(PCPLPRequest const& req);
+PCPLPRequest decode_pcplp_request(std::string const& body);
+
+std::string encode_delivery_request(DeliveryProblem const& prob);
+DeliveryProblem decode_delivery_request(std::string const& body);
+
+std::string encode_pcplp_response(Schedule const& s);
+Schedule decode_pcplp_response(std::string const& body);
+
+std::string encode_delivery_response(DeliveryQPResult const& r);
+DeliveryQPResult decode_delivery_response(std::string const& body);
+
+
+// кадр целиком: заголовок и тело
+std::string make_frame(FrameHeader h, std::string const& body);
+
+
+#endif
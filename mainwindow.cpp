@@ -19,6 +19,7 @@
 #include <QGraphicsLineItem>
 #include <QGraphicsPolygonItem>
 #include <cmath>
+#include <stdexcept>
 
 
 using namespace QtCharts;
@@ -636,7 +637,13 @@ void MainWindow::on_solveZkprBtn_clicked()
     const VecVeci preds = readPreds(ui->predsTable, N);
 
     // Решаем
-    const Schedule s = solve_PCPLP(N, M, dur, rel, cap, demands, preds);
+    Schedule s;
+    try {
+        s = solve_PCPLP(N, M, dur, rel, cap, demands, preds);
+    } catch (const std::invalid_argument& e) {
+        QMessageBox::warning(this, "Ошибка", QString("Некорректные данные: %1").arg(e.what()));
+        return;
+    }
 
     // Вывод
     ui->scheduleTable->setRowCount(N);
@@ -0,0 +1,368 @@
+// сервер решателей: долгоживущий процесс, принимает запросы планирования и ритмичной поставки
+// по локальному сокету (протокол - core/solver_protocol.h); рабочие потоки и их рабочие области
+// декодера живут между запросами, ответы приходят по мере готовности с номером запроса
+//
+// запуск: solver_daemon <путь к сокету> [число рабочих потоков]
+
+#include "core/solver_protocol.h"
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <poll.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> stopping{false};
+
+extern "C" void on_signal(int) { stopping.store(true); }
+
+
+// чтение ровно n байт; false - соединение закрыто или ошибка
+bool read_all(int fd, char* buf, size_t n)
+{
+    while (n > 0) {
+        const ssize_t k = ::read(fd, buf, n);
+        if (k < 0 && errno == EINTR) continue;
+        if (k <= 0) return false;
+        buf += k;
+        n -= (size_t)k;
+    }
+    return true;
+}
+
+
+// чтение тела кадра порциями: память растёт по мере прихода данных, а не по заявленной длине
+bool read_body(int fd, std::string& body, size_t n)
+{
+    char chunk[64 * 1024];
+    body.clear();
+    while (n > 0) {
+        const size_t k = std::min(n, sizeof(chunk));
+        if (!read_all(fd, chunk, k)) return false;
+        body.append(chunk, k);
+        n -= k;
+    }
+    return true;
+}
+
+
+// соединение с клиентом: ответы пишутся целыми кадрами под мьютексом, сокет закрывается с последней ссылкой
+class Connection {
+
+public:
+
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() { ::close(fd); }
+
+    Connection(Connection const&) = delete;
+    Connection& operator=(Connection const&) = delete;
+
+    int handle() const { return fd; }
+
+    bool send(std::string const& frame) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const char* p = frame.data();
+        size_t n = frame.size();
+        while (n > 0) {
+            const ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+            if (k < 0 && errno == EINTR) continue;
+            if (k <= 0) return false;
+            p += k;
+            n -= (size_t)k;
+        }
+        return true;
+    }
+
+private:
+
+    int fd;
+    std::mutex writeMutex;
+
+};
+
+
+struct Task {
+
+    std::shared_ptr<Connection> conn;
+    FrameHeader head;
+    std::string body;
+    Clock::time_point received;
+
+};
+
+
+// решение одного запроса в рабочей области потока
+void handle(Task& t, DecoderWS& ws)
+{
+    FrameHeader reply;
+    reply.id = t.head.id;
+    std::string body;
+    try {
+
+        // срок отсчитывается от получения кадра; истёк в очереди - решать не начинаем
+        double remaining = 0;
+        if (t.head.deadlineMs > 0) {
+            const auto until = t.received + std::chrono::milliseconds(t.head.deadlineMs);
+            remaining = std::chrono::duration<double>(until - Clock::now()).count();
+            if (remaining <= 0) {
+                reply.type = (uint16_t)Status::DeadlineExpired;
+                t.conn->send(make_frame(reply, "deadline expired before the request was started"));
+                return;
+            }
+        }
+
+        switch ((MsgType)t.head.type) {
+        case MsgType::Ping:
+            break;
+        case MsgType::PCPLP: {
+            PCPLPRequest req = decode_pcplp_request(t.body);
+            SolveOptions opt;
+            opt.decoder = req.decoder;
+            opt.engine = req.engine;
+            opt.objective = req.objective;
+            opt.deadline = req.deadline;
+            opt.timeLimit = remaining; // поиск обрывается на поколении, в котором истёк срок
+            body = encode_pcplp_response(solve_PCPLP(std::move(req.inst), opt, ws));
+            break;
+        }
+        case MsgType::Delivery:
+            body = encode_delivery_response(solve_rhythmic_delivery_general(decode_delivery_request(t.body)));
+            break;
+        default:
+            throw std::invalid_argument("unknown request type " + std::to_string(t.head.type));
+        }
+        reply.type = (uint16_t)Status::Ok;
+
+    } catch (std::invalid_argument const& e) {
+        reply.type = (uint16_t)Status::BadRequest;
+        body = e.what();
+    } catch (std::exception const& e) {
+        reply.type = (uint16_t)Status::Failed;
+        body = e.what();
+    }
+    t.conn->send(make_frame(reply, body));
+}
+
+
+// пул рабочих потоков: очередь задач, у каждого потока своя рабочая область декодера на всё время работы;
+// деструктор дорешивает очередь
+class WorkerPool {
+
+public:
+
+    explicit WorkerPool(int threads) {
+        for (int k = 0; k < threads; ++k) pool.emplace_back([this]() { run(); });
+    }
+
+    ~WorkerPool() {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            closing = true;
+        }
+        cv.notify_all();
+        for (auto& th : pool) th.join();
+    }
+
+    void submit(Task t) {
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue.push_back(std::move(t));
+        }
+        cv.notify_one();
+    }
+
+private:
+
+    void run() {
+        DecoderWS ws; // буферы растут до размера самых больших задач и переиспользуются
+        while (true) {
+            Task t;
+            {
+                std::unique_lock<std::mutex> lock(mtx);
+                cv.wait(lock, [this]() { return closing || !queue.empty(); });
+                if (queue.empty()) return;
+                t = std::move(queue.front());
+                queue.pop_front();
+            }
+            handle(t, ws);
+        }
+    }
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    std::deque<Task> queue;
+    bool closing = false;
+    std::vector<std::thread> pool;
+
+};
+
+
+// учёт потоков чтения: при остановке их сокеты закрываются на чтение, и сервер ждёт их выхода
+class Readers {
+
+public:
+
+    void add(std::shared_ptr<Connection> const& c) {
+        std::lock_guard<std::mutex> lock(mtx);
+        ++active;
+        conns.erase(std::remove_if(conns.begin(), conns.end(), [](auto const& w) { return w.expired(); }),
+                    conns.end());
+        conns.push_back(c);
+    }
+
+    void done() {
+        std::lock_guard<std::mutex> lock(mtx);
+        --active;
+        cv.notify_all();
+    }
+
+    void shutdown_and_wait() {
+        std::unique_lock<std::mutex> lock(mtx);
+        for (auto& w : conns)
+            if (auto c = w.lock()) ::shutdown(c->handle(), SHUT_RD);
+        cv.wait(lock, [this]() { return active == 0; });
+    }
+
+private:
+
+    std::mutex mtx;
+    std::condition_variable cv;
+    int active = 0;
+    std::vector<std::weak_ptr<Connection>> conns;
+
+};
+
+
+// чтение кадров соединения и постановка их в очередь; испорченный поток кадров закрывает соединение
+void serve_connection(std::shared_ptr<Connection> conn, WorkerPool& workers, Readers& readers)
+{
+    char raw[frame_header_size];
+    while (read_all(conn->handle(), raw, frame_header_size)) {
+        Task t;
+        try {
+            t.head = read_header(raw);
+        } catch (std::invalid_argument const& e) {
+            FrameHeader reply;
+            reply.type = (uint16_t)Status::BadRequest;
+            conn->send(make_frame(reply, e.what()));
+            break;
+        }
+        if (t.head.bytes > max_request_body(t.head.type)) {
+            FrameHeader reply;
+            reply.type = (uint16_t)Status::BadRequest;
+            reply.id = t.head.id;
+            conn->send(make_frame(reply, "frame body too large for its request type"));
+            break;
+        }
+        if (!read_body(conn->handle(), t.body, t.head.bytes)) break;
+        t.conn = conn;
+        t.received = Clock::now();
+        workers.submit(std::move(t));
+    }
+    readers.done();
+}
+
+
+int open_listener(std::string const& path)
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) throw std::runtime_error("socket path is too long");
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) throw std::runtime_error(std::string("socket: ") + std::strerror(errno));
+
+    // оставшийся от упавшего процесса сокет удаляется; работающий сервер или не сокет по этому пути - ошибка
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0) {
+        ::close(fd);
+        throw std::runtime_error("another server is listening on " + path);
+    }
+    const int connectErr = errno;
+    struct stat st;
+    if (::lstat(path.c_str(), &st) == 0) {
+        if (connectErr != ECONNREFUSED || !S_ISSOCK(st.st_mode)) {
+            ::close(fd);
+            throw std::runtime_error("path exists and is not a socket: " + path);
+        }
+        ::unlink(path.c_str());
+    }
+
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 || ::listen(fd, 64) != 0) {
+        const std::string err = std::strerror(errno);
+        ::close(fd);
+        throw std::runtime_error("cannot listen on " + path + ": " + err);
+    }
+    return fd;
+}
+
+} // namespace
+
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: %s <socket path> [threads]\n", argv[0]);
+        return 2;
+    }
+    const std::string path = argv[1];
+    int threads = argc > 2 ? std::atoi(argv[2]) : 0;
+    if (threads <= 0) threads = std::max(1u, std::thread::hardware_concurrency());
+
+    std::signal(SIGINT, on_signal);
+    std::signal(SIGTERM, on_signal);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    int listener = -1;
+    try {
+        listener = open_listener(path);
+    } catch (std::exception const& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    {
+        WorkerPool workers(threads);
+        Readers readers;
+
+        // приём соединений; опрос с таймаутом, чтобы заметить сигнал остановки
+        while (!stopping.load()) {
+            pollfd pfd{listener, POLLIN, 0};
+            const int r = ::poll(&pfd, 1, 200);
+            if (r <= 0) continue;
+            const int fd = ::accept(listener, nullptr, nullptr);
+            if (fd < 0) continue;
+            auto conn = std::make_shared<Connection>(fd);
+            readers.add(conn);
+            std::thread(serve_connection, conn, std::ref(workers), std::ref(readers)).detach();
+        }
+
+        ::close(listener);
+        ::unlink(path.c_str());
+        readers.shutdown_and_wait(); // новые задачи больше не приходят
+    }                                // пул дорешивает очередь и отвечает
+
+    return 0;
+}